@@ -0,0 +1,356 @@
+#include "assetloader.h"
+
+#include <iostream>
+#include <string.h>
+
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <assimp/Importer.hpp>
+
+#include "meshcache.h"
+#include "texturecache.h"
+
+const unsigned int MESH_IMPORT_FLAGS = aiProcessPreset_TargetRealtime_MaxQuality;
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	stopping = false;
+	if (threadCount == 0)
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		threadCount = cores > 1 ? cores - 1 : 1;
+	}
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+void ThreadPool::submit(const std::function<void()>& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		tasks.push_back(task);
+	}
+	wakeUp.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			wakeUp.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty()) return;
+			task = tasks.front();
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void importMesh(const std::string& file_name, MeshData& mesh_data) {
+	Assimp::Importer importer;
+	importer.ReadFile(file_name, MESH_IMPORT_FLAGS);
+	const aiScene* scene = importer.GetScene();
+	//One vertex per triangle corner, welded into unique vertices at the end
+	std::vector<GLfloat> data;
+
+	if (scene) {
+		if (scene->HasMeshes()) {
+			for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+				const struct aiMesh* mesh = scene->mMeshes[i];
+				for (unsigned int t = 0; t < mesh->mNumFaces; ++t) {
+					const struct aiFace* face = &mesh->mFaces[t];
+					if (face->mNumIndices != 3) {
+						std::cout << "WARNING " << __FILE__ << " : " << __LINE__ << " - faces are not triangulated" << std::endl;
+					}
+					for (unsigned int j = 0; j < face->mNumIndices; j++) {
+						int index = face->mIndices[j];
+
+						//Vertex positions
+						data.push_back(mesh->mVertices[index].x); data.push_back(mesh->mVertices[index].z); data.push_back(mesh->mVertices[index].y);
+
+						//Vertex normals
+						if (mesh->mNormals != NULL) {
+							//If we have normals, push them back next
+							data.push_back(mesh->mNormals[index].x); data.push_back(mesh->mNormals[index].z); data.push_back(mesh->mNormals[index].y);
+						}
+						else {
+							//If not, just set to zero, but warn the user as this will likely make the lighting null
+							data.push_back(0); data.push_back(0); data.push_back(0);
+							std::cout << "WARNING: No normals loaded for mesh " << file_name << std::endl;
+						}
+
+						//Vertex colours
+						if (mesh->mColors[0] != NULL) {
+							//If we have colours, append them
+							data.push_back(mesh->mColors[index]->r); data.push_back(mesh->mColors[index]->g); data.push_back(mesh->mColors[index]->b);
+						}
+						else {
+							//If no colours, push back white
+							data.push_back(1); data.push_back(1); data.push_back(1);
+						}
+
+						//Texture coords
+						if (mesh->mTextureCoords[0] != NULL) {
+							//Push back textures
+							data.push_back(mesh->mTextureCoords[0][index].x); data.push_back(1 - mesh->mTextureCoords[0][index].y);
+						}
+						else {
+							data.push_back(0); data.push_back(0);
+						}
+					}
+				}
+			}
+		}
+	}
+	else {
+		std::cout << "No object found! - Looking for " << file_name << std::endl;
+	}
+
+	//Share identical vertices and reorder for the post-transform cache and overdraw
+	weldVertices(data, mesh_data);
+	float weldedACMR = computeACMR(mesh_data.indices, mesh_data.vertexCount(), ACMR_CACHE_SIZE);
+	optimizeMesh(mesh_data);
+	std::cout << file_name << ": " << data.size() / VERTEX_FLOATS << " -> " << mesh_data.vertexCount() << " vertices, ACMR 3.00 -> "
+		<< weldedACMR << " welded -> " << computeACMR(mesh_data.indices, mesh_data.vertexCount(), ACMR_CACHE_SIZE) << " optimised" << std::endl;
+}
+
+bool importMeshPositions(const std::string& file_name, std::vector<float>& vertices, std::vector<int>& indices) {
+	MeshData data;
+	importMesh(file_name, data);
+	if (data.indices.empty()) return false;
+	vertices.resize(data.vertexCount() * 3);
+	for (size_t i = 0; i < data.vertexCount(); i++) {
+		for (int k = 0; k < 3; k++) vertices[i * 3 + k] = data.vertices[i * VERTEX_FLOATS + k];
+	}
+	indices.assign(data.indices.begin(), data.indices.end());
+	return true;
+}
+
+AssetLoader::AssetLoader(unsigned int threadCount) : pool(threadCount)
+{
+	pending = 0;
+	vertexFormat = FORMAT_HALF_POSITIONS;
+	textureFormat = GLEW_EXT_texture_compression_s3tc ? TEXTURE_COMPRESS : 0;
+
+	//Plain white 1x1 texture to draw with until the real ones arrive
+	unsigned char white[3] = { 255, 255, 255 };
+	glGenTextures(1, &placeholderTex);
+	glBindTexture(GL_TEXTURE_2D, placeholderTex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+AssetLoader::~AssetLoader()
+{
+	//Workers may still be queueing uploads, the pool finishes and joins them when it is destroyed.
+	//Anything they queue after this point is never run and its GL objects are never created.
+	//None of them may be left waiting for ring space that will never be freed.
+	uploads.shutdown();
+}
+
+//What a worker reads one mesh from
+struct PreparedMesh
+{
+	MeshCacheFile cache;
+	bool fromCache;
+	MeshData data;           //Only filled when the cache couldn't be used
+	PackedVertices vertices; //Ditto
+};
+
+MeshHandle AssetLoader::loadMesh(const std::string& name)
+{
+	MeshHandle asset = std::make_shared<MeshAsset>();
+	asset->name = name;
+	asset->ready = false;
+	asset->mesh.numIndices = 0;
+	pending++;
+
+	unsigned int formatFlags = vertexFormat;
+	pool.submit([this, asset, formatFlags]() {
+		//Use the precompiled mesh if it was built from this exact file with these import and format flags
+		PreparedMesh prepared;
+		std::string cacheName = asset->name + ".meshcache";
+		unsigned long long sourceHash = hashFile(asset->name);
+		prepared.fromCache = prepared.cache.open(cacheName, sourceHash, MESH_IMPORT_FLAGS, formatFlags);
+		if (!prepared.fromCache) {
+			//Load mesh with ASSIMP, pack it and write the cache for next time
+			importMesh(asset->name, prepared.data);
+			packVertices(prepared.data, formatFlags, prepared.vertices);
+			if (!prepared.data.indices.empty() && writeMeshCache(cacheName, prepared.data, prepared.vertices, sourceHash, MESH_IMPORT_FLAGS, formatFlags)) {
+				prepared.fromCache = prepared.cache.open(cacheName, sourceHash, MESH_IMPORT_FLAGS, formatFlags);
+			}
+		}
+
+		//Everything but the GL names, filled in here and copied over on the GL thread
+		Mesh info = Mesh();
+		const void* vertexData;
+		const void* indexData;
+		size_t vertexBytes, indexBytes;
+		std::vector<unsigned char> packedIndices;
+		if (prepared.fromCache) {
+			const MeshCacheHeader& header = prepared.cache.getHeader();
+			info.numIndices = header.indexCount;
+			info.indexType = header.indexType;
+			info.layout = prepared.cache.getLayout();
+			info.positionScale = header.positionScale;
+			for (int k = 0; k < 3; k++) {
+				info.boundsMin[k] = header.boundsMin[k];
+				info.boundsMax[k] = header.boundsMax[k];
+				info.positionOffset[k] = header.positionOffset[k];
+			}
+			vertexData = prepared.cache.getVertexData();
+			vertexBytes = prepared.cache.getVertexBytes();
+			indexData = prepared.cache.getIndexData();
+			indexBytes = prepared.cache.getIndexBytes();
+		}
+		else if (!prepared.data.indices.empty()) {
+			//Couldn't write the cache, stage straight from memory instead
+			packIndices(prepared.data, packedIndices, info.indexType);
+			computeBounds(prepared.data, info.boundsMin, info.boundsMax);
+			info.numIndices = (int)prepared.data.indices.size();
+			info.layout = prepared.vertices.layout;
+			info.positionScale = prepared.vertices.positionScale;
+			for (int k = 0; k < 3; k++) info.positionOffset[k] = prepared.vertices.positionOffset[k];
+			vertexData = &prepared.vertices.data[0];
+			vertexBytes = prepared.vertices.data.size();
+			indexData = &packedIndices[0];
+			indexBytes = packedIndices.size();
+		}
+		else {
+			std::cout << "Model Empty!! - " << asset->name << std::endl;
+			pending--;
+			return;
+		}
+
+		//Vertices then indices in one block, copied into their buffers on the GL thread
+		StagingHandle staging = uploads.allocate(vertexBytes + indexBytes);
+		memcpy(staging->getData(), vertexData, vertexBytes);
+		memcpy(staging->getData() + vertexBytes, indexData, indexBytes);
+
+		uploads.submit(staging, [this, asset, info, vertexBytes, indexBytes](const StagingBlock& block) {
+			Mesh& mesh = asset->mesh;
+			mesh = info;
+			glGenVertexArrays(1, &mesh.vao);
+			glGenBuffers(1, &mesh.vbo);
+			glGenBuffers(1, &mesh.ibo);
+			glBindVertexArray(mesh.vao);
+
+			//Storage only, the data comes out of the staging block
+			glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+			glBufferData(GL_ARRAY_BUFFER, vertexBytes, NULL, GL_STATIC_DRAW);
+			block.copyToBuffer(GL_ARRAY_BUFFER, 0, 0, vertexBytes);
+			//The element buffer binding is stored in the VAO
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, NULL, GL_STATIC_DRAW);
+			block.copyToBuffer(GL_ELEMENT_ARRAY_BUFFER, 0, vertexBytes, indexBytes);
+
+			if (meshReadyCallback) meshReadyCallback(mesh);
+			asset->ready = true;
+			pending--;
+		});
+	});
+	return asset;
+}
+
+//What a worker reads one texture from
+struct PreparedTexture
+{
+	TextureCacheFile cache;
+	bool fromCache;
+	TextureData data; //Only filled when the cache couldn't be used
+};
+
+TextureHandle AssetLoader::loadTexture(const std::string& name)
+{
+	TextureHandle asset = std::make_shared<TextureAsset>();
+	asset->name = name;
+	asset->texture = placeholderTex;
+	asset->ready = false;
+	pending++;
+
+	unsigned int formatFlags = textureFormat;
+	pool.submit([this, asset, formatFlags]() {
+		//Use the compressed mip chain if it was built from this exact image with these format flags
+		PreparedTexture prepared;
+		std::string cacheName = asset->name + ".texcache";
+		unsigned long long sourceHash = hashFile(asset->name);
+		prepared.fromCache = prepared.cache.open(cacheName, sourceHash, formatFlags);
+		if (!prepared.fromCache) {
+			//Decode, build mips and compress, then write the cache for next time
+			if (!importTexture(asset->name, formatFlags, prepared.data)) {
+				std::cout << "Texture failed to load! - " << asset->name << std::endl;
+				pending--;
+				return;
+			}
+			if (writeTextureCache(cacheName, prepared.data, sourceHash, formatFlags)) {
+				prepared.fromCache = prepared.cache.open(cacheName, sourceHash, formatFlags);
+			}
+		}
+
+		std::vector<const void*> levelData;
+		std::vector<size_t> levelBytes;
+		GLenum internalFormat;
+		int width, height;
+		if (prepared.fromCache) {
+			//Straight from the mapped file, nothing to decode
+			const TextureCacheHeader& header = prepared.cache.getHeader();
+			internalFormat = header.internalFormat;
+			width = header.width;
+			height = header.height;
+			for (unsigned int i = 0; i < header.levels; i++) {
+				levelData.push_back(prepared.cache.getLevelData(i));
+				levelBytes.push_back(prepared.cache.getLevelBytes(i));
+			}
+		}
+		else {
+			//Couldn't write the cache, stage straight from memory instead
+			internalFormat = prepared.data.internalFormat;
+			width = prepared.data.width;
+			height = prepared.data.height;
+			for (size_t i = 0; i < prepared.data.levels.size(); i++) {
+				levelData.push_back(&prepared.data.levels[i][0]);
+				levelBytes.push_back(prepared.data.levels[i].size());
+			}
+		}
+
+		//The whole chain in one block, level after level
+		size_t totalBytes = 0;
+		std::vector<size_t> levelOffsets;
+		for (size_t i = 0; i < levelBytes.size(); i++) {
+			levelOffsets.push_back(totalBytes);
+			totalBytes += levelBytes[i];
+		}
+		StagingHandle staging = uploads.allocate(totalBytes);
+		for (size_t i = 0; i < levelBytes.size(); i++) memcpy(staging->getData() + levelOffsets[i], levelData[i], levelBytes[i]);
+
+		uploads.submit(staging, [this, asset, internalFormat, width, height, levelOffsets, levelBytes](const StagingBlock& block) {
+			std::vector<const void*> levelPixels;
+			for (size_t i = 0; i < levelOffsets.size(); i++) levelPixels.push_back(block.getPixels(levelOffsets[i]));
+			asset->texture = uploadTexture(internalFormat, width, height, (int)levelPixels.size(), &levelPixels[0], &levelBytes[0]);
+			asset->ready = true;
+			pending--;
+		});
+	});
+	return asset;
+}
+
+void AssetLoader::processUploads()
+{
+	uploads.process();
+}
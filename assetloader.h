@@ -0,0 +1,109 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "mesh.h"
+#include "uploadmanager.h"
+
+//Assimp post processing flags meshes are imported with, part of the mesh cache key
+extern const unsigned int MESH_IMPORT_FLAGS;
+
+//Fixed set of worker threads pulling tasks off a shared queue
+class ThreadPool
+{
+protected:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()> > tasks;
+	std::mutex queueMutex;
+	std::condition_variable wakeUp;
+	bool stopping;
+
+	void workerLoop();
+
+public:
+	//0 threads means one per core, leaving one for the GL thread
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	void submit(const std::function<void()>& task);
+	unsigned int size() const { return (unsigned int)workers.size(); }
+};
+
+//A mesh that becomes drawable once its buffers have been created on the GL thread
+struct MeshAsset
+{
+	std::string name;
+	Mesh mesh;
+	std::atomic<bool> ready;
+};
+typedef std::shared_ptr<MeshAsset> MeshHandle;
+
+//A texture that shows the loader's placeholder until the real image is uploaded
+struct TextureAsset
+{
+	std::string name;
+	GLuint texture;
+	std::atomic<bool> ready;
+};
+typedef std::shared_ptr<TextureAsset> TextureHandle;
+
+//Imports meshes and decodes textures on a worker pool, which also copies them into staging memory.
+//Only the GL calls run on the context thread, a budgeted amount each frame.
+//Must be created and pumped on the thread that owns the GL context.
+class AssetLoader
+{
+protected:
+	UploadManager uploads;                      //Workers stage asset data here, it is copied to GL objects on the GL thread
+	std::atomic<int> pending;                   //Assets requested but not yet uploaded
+	GLuint placeholderTex;
+	unsigned int vertexFormat;                  //vertex_format_t flags for meshes loaded from now on
+	unsigned int textureFormat;                 //texture_format_t flags for textures loaded from now on
+	std::function<void(Mesh&)> meshReadyCallback;
+	ThreadPool pool;                            //Declared last so workers are joined before anything they use is destroyed
+
+public:
+	AssetLoader(unsigned int threadCount = 0);
+	~AssetLoader();
+
+	//Called on the GL thread with the mesh's VAO bound, once its buffers exist. Used to link attributes.
+	void setMeshReadyCallback(const std::function<void(Mesh&)>& callback) { meshReadyCallback = callback; }
+
+	//Flags passed to packVertices(), FORMAT_HALF_POSITIONS by default
+	void setVertexFormat(unsigned int formatFlags) { vertexFormat = formatFlags; }
+
+	//Flags passed to importTexture(), TEXTURE_COMPRESS by default when the driver has S3TC
+	void setTextureFormat(unsigned int formatFlags) { textureFormat = formatFlags; }
+
+	MeshHandle loadMesh(const std::string& name);
+	TextureHandle loadTexture(const std::string& name);
+
+	//Copy finished assets into GL objects, as many as the per frame upload budget allows. Call once per frame on the GL thread.
+	void processUploads();
+
+	//Bytes and time processUploads() may spend each frame, 4MB and 2ms by default
+	void setUploadBudget(size_t bytesPerFrame, double millisPerFrame) { uploads.setBudget(bytesPerFrame, millisPerFrame); }
+	UploadStats getUploadStats() { return uploads.getStats(); }
+
+	//True once every requested asset has been uploaded
+	bool isIdle() const { return pending == 0; }
+
+	GLuint getPlaceholderTexture() const { return placeholderTex; }
+};
+
+//Import a mesh with Assimp, then weld and optimise it. Thread safe.
+void importMesh(const std::string& file_name, MeshData& mesh_data);
+//Just the welded positions and indices of importMesh(), what ShapeCache builds collision shapes from
+bool importMeshPositions(const std::string& file_name, std::vector<float>& vertices, std::vector<int>& indices);
+
+#endif // ASSETLOADER_H
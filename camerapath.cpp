@@ -0,0 +1,91 @@
+#include "camerapath.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool CameraPath::load(const std::string& fileName)
+{
+	std::ifstream file(fileName.c_str());
+	if (!file)
+	{
+		std::cout << "No camera path found! - Looking for " << fileName << std::endl;
+		return false;
+	}
+
+	keys.clear();
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) line.erase(comment);
+
+		std::istringstream in(line);
+		CameraKey key;
+		if (!(in >> key.time)) continue; //Blank line
+		if (!(in >> key.position.x >> key.position.y >> key.position.z >> key.rotation.x >> key.rotation.y >> key.rotation.z))
+		{
+			std::cout << "WARNING: " << fileName << " line " << lineNumber << " isn't a camera key, skipped" << std::endl;
+			continue;
+		}
+		if (!keys.empty() && key.time < keys.back().time)
+		{
+			std::cout << "WARNING: " << fileName << " line " << lineNumber << " goes back in time, skipped" << std::endl;
+			continue;
+		}
+		keys.push_back(key);
+	}
+	return !keys.empty();
+}
+
+bool CameraPath::save(const std::string& fileName) const
+{
+	std::ofstream file(fileName.c_str());
+	if (!file) return false;
+	file << "#time x y z pitch yaw roll" << std::endl;
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		const CameraKey& key = keys[i];
+		file << key.time << " " << key.position.x << " " << key.position.y << " " << key.position.z << " "
+			<< key.rotation.x << " " << key.rotation.y << " " << key.rotation.z << std::endl;
+	}
+	return (bool)file;
+}
+
+void CameraPath::add(double time, const glm::vec3& position, const glm::vec3& rotation)
+{
+	CameraKey key = { time, position, rotation };
+	keys.push_back(key);
+}
+
+void CameraPath::sample(double time, glm::vec3& position, glm::vec3& rotation) const
+{
+	if (time <= keys.front().time || keys.size() == 1)
+	{
+		position = keys.front().position;
+		rotation = keys.front().rotation;
+		return;
+	}
+	if (time >= keys.back().time)
+	{
+		position = keys.back().position;
+		rotation = keys.back().rotation;
+		return;
+	}
+
+	//First key after time, there is always one before it
+	size_t low = 0, high = keys.size() - 1;
+	while (high - low > 1)
+	{
+		size_t middle = (low + high) / 2;
+		if (keys[middle].time > time) high = middle;
+		else low = middle;
+	}
+	const CameraKey& a = keys[low];
+	const CameraKey& b = keys[high];
+	float t = b.time > a.time ? float((time - a.time) / (b.time - a.time)) : 1.0f;
+	position = glm::mix(a.position, b.position, t);
+	rotation = glm::mix(a.rotation, b.rotation, t);
+}
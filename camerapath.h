@@ -0,0 +1,40 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+//Where the camera was at one moment of a path
+struct CameraKey
+{
+	double time;        //Seconds from the start of the path
+	glm::vec3 position;
+	glm::vec3 rotation; //Degrees, as Camera keeps it
+};
+
+//A camera flight recorded with K, or written by hand, played back by the headless benchmark.
+//Path files are plain text, one key per line in time order, '#' starts a comment:
+//
+//  <time> <x y z> <pitch yaw roll>
+class CameraPath
+{
+protected:
+	std::vector<CameraKey> keys;
+
+public:
+	bool load(const std::string& fileName);
+	bool save(const std::string& fileName) const;
+
+	void add(double time, const glm::vec3& position, const glm::vec3& rotation);
+	void clear() { keys.clear(); }
+	bool empty() const { return keys.empty(); }
+	size_t size() const { return keys.size(); }
+	double getDuration() const { return keys.empty() ? 0 : keys.back().time; }
+
+	//Linearly between the keys either side of time, held at the ends. The path mustn't be empty.
+	void sample(double time, glm::vec3& position, glm::vec3& rotation) const;
+};
+
+#endif // CAMERAPATH_H
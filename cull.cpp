@@ -0,0 +1,101 @@
+#include "cull.h"
+
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULL_SSE
+#include <xmmintrin.h>
+#endif
+
+Frustum makeFrustum(const glm::mat4& viewProj)
+{
+	//Gribb & Hartmann: each plane is the last row of the matrix plus or minus one of the others.
+	//glm is column major, so row r is (m[0][r], m[1][r], m[2][r], m[3][r]).
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++) rows[r] = glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0]; //Left
+	frustum.planes[1] = rows[3] - rows[0]; //Right
+	frustum.planes[2] = rows[3] + rows[1]; //Bottom
+	frustum.planes[3] = rows[3] - rows[1]; //Top
+	frustum.planes[4] = rows[3] + rows[2]; //Near
+	frustum.planes[5] = rows[3] - rows[2]; //Far
+	return frustum;
+}
+
+BoundsList::BoundsList()
+{
+	count = 0;
+}
+
+void BoundsList::resize(size_t newCount)
+{
+	count = newCount;
+	size_t padded = (newCount + 3) & ~(size_t)3;
+	centreX.resize(padded, 0); centreY.resize(padded, 0); centreZ.resize(padded, 0);
+	extentX.resize(padded, 0); extentY.resize(padded, 0); extentZ.resize(padded, 0);
+}
+
+void BoundsList::set(size_t index, const float boundsMin[3], const float boundsMax[3], const glm::mat4& model)
+{
+	glm::vec4 centre = model * glm::vec4((boundsMin[0] + boundsMax[0]) / 2, (boundsMin[1] + boundsMax[1]) / 2, (boundsMin[2] + boundsMax[2]) / 2, 1);
+	float extent[3] = { (boundsMax[0] - boundsMin[0]) / 2, (boundsMax[1] - boundsMin[1]) / 2, (boundsMax[2] - boundsMin[2]) / 2 };
+
+	//The world box that holds the rotated box: each axis gets the absolute projection of all three local extents
+	float world[3];
+	for (int r = 0; r < 3; r++)
+	{
+		world[r] = fabsf(model[0][r]) * extent[0] + fabsf(model[1][r]) * extent[1] + fabsf(model[2][r]) * extent[2];
+	}
+	centreX[index] = centre.x; centreY[index] = centre.y; centreZ[index] = centre.z;
+	extentX[index] = world[0]; extentY[index] = world[1]; extentZ[index] = world[2];
+}
+
+void BoundsList::cull(const Frustum& frustum, std::vector<unsigned char>& visible) const
+{
+	visible.resize(centreX.size());
+	//A box is outside if it is entirely behind any one plane, i.e. even its corner furthest along the normal is behind it
+#ifdef CULL_SSE
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		absX[p] = _mm_andnot_ps(signMask, planeX[p]);
+		absY[p] = _mm_andnot_ps(signMask, planeY[p]);
+		absZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+	}
+	for (size_t i = 0; i < centreX.size(); i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&centreX[i]), cy = _mm_loadu_ps(&centreY[i]), cz = _mm_loadu_ps(&centreZ[i]);
+		__m128 ex = _mm_loadu_ps(&extentX[i]), ey = _mm_loadu_ps(&extentY[i]), ez = _mm_loadu_ps(&extentZ[i]);
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)), _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(outside);
+		for (int k = 0; k < 4; k++) visible[i + k] = (mask & (1 << k)) ? 0 : 1;
+	}
+#else
+	for (size_t i = 0; i < centreX.size(); i++)
+	{
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = plane.x * centreX[i] + plane.y * centreY[i] + plane.z * centreZ[i] + plane.w;
+			float radius = fabsf(plane.x) * extentX[i] + fabsf(plane.y) * extentY[i] + fabsf(plane.z) * extentZ[i];
+			outside = distance + radius < 0;
+		}
+		visible[i] = outside ? 0 : 1;
+	}
+#endif
+	visible.resize(count);
+}
@@ -0,0 +1,47 @@
+#ifndef CULL_H
+#define CULL_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+//Six clip planes, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+//Planes of proj * view, in world space. Works for mirrored views like the portal cameras too.
+Frustum makeFrustum(const glm::mat4& viewProj);
+
+//How much of a pass made it to the render queue
+struct CullStats
+{
+	int submitted;
+	int culled;
+};
+
+//World space boxes stored as one array per component, so the frustum test can do four boxes at a time
+class BoundsList
+{
+protected:
+	size_t count;
+	//Padded to a multiple of 4, the padding boxes are never reported
+	std::vector<float> centreX, centreY, centreZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+public:
+	BoundsList();
+
+	void resize(size_t newCount);
+	size_t size() const { return count; }
+
+	//Box index becomes the object space box min..max moved by model
+	void set(size_t index, const float boundsMin[3], const float boundsMax[3], const glm::mat4& model);
+
+	//visible[i] is 1 if box i is at least partly inside the frustum, 0 otherwise
+	void cull(const Frustum& frustum, std::vector<unsigned char>& visible) const;
+};
+
+#endif // CULL_H
@@ -0,0 +1,105 @@
+#include "filemapping.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileMapping::FileMapping()
+{
+	data = NULL;
+	length = 0;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	fileHandle = -1;
+#endif
+}
+
+FileMapping::~FileMapping()
+{
+	close();
+}
+
+bool FileMapping::open(const std::string& path)
+{
+	close();
+#ifdef _WIN32
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	length = (size_t)size.QuadPart;
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL)
+	{
+		close();
+		return false;
+	}
+	data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+	fileHandle = ::open(path.c_str(), O_RDONLY);
+	if (fileHandle < 0) return false;
+
+	struct stat info;
+	if (fstat(fileHandle, &info) != 0 || info.st_size == 0)
+	{
+		close();
+		return false;
+	}
+	length = (size_t)info.st_size;
+
+	void* view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileHandle, 0);
+	data = (view == MAP_FAILED) ? NULL : (const unsigned char*)view;
+#endif
+	if (data == NULL)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void FileMapping::close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data) munmap((void*)data, length);
+	if (fileHandle >= 0) ::close(fileHandle);
+	fileHandle = -1;
+#endif
+	data = NULL;
+	length = 0;
+}
+
+unsigned long long hashFile(const std::string& path)
+{
+	FileMapping file;
+	if (!file.open(path)) return 0;
+
+	unsigned long long hash = 14695981039346656037ull;
+	const unsigned char* bytes = file.getData();
+	for (size_t i = 0; i < file.getLength(); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
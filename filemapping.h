@@ -0,0 +1,38 @@
+#ifndef FILEMAPPING_H
+#define FILEMAPPING_H
+
+#include <stddef.h>
+#include <string>
+
+//Read only view of a whole file in memory
+class FileMapping
+{
+protected:
+	const unsigned char* data;
+	size_t length;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileHandle;
+#endif
+
+	//Owns the mapping, so not copyable
+	FileMapping(const FileMapping&);
+	FileMapping& operator=(const FileMapping&);
+
+public:
+	FileMapping();
+	~FileMapping();
+
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* getData() const { return data; }
+	size_t getLength() const { return length; }
+};
+
+//64 bit FNV-1a of a file's contents, 0 if it can't be read
+unsigned long long hashFile(const std::string& path);
+
+#endif // FILEMAPPING_H
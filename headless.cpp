@@ -0,0 +1,154 @@
+#include "headless.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <SOIL.h>
+
+HeadlessContext::HeadlessContext()
+{
+	display = EGL_NO_DISPLAY;
+	context = EGL_NO_CONTEXT;
+	framebuffer = colour = depth = 0;
+	width = height = 0;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	if (framebuffer)
+	{
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(1, &colour);
+		glDeleteRenderbuffers(1, &depth);
+	}
+	if (context != EGL_NO_CONTEXT)
+	{
+		eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+	}
+	if (display != EGL_NO_DISPLAY) eglTerminate((EGLDisplay)display);
+}
+
+bool HeadlessContext::create()
+{
+	//Mesa's surfaceless platform needs neither X nor a GPU, fall back to whatever the default display is
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (eglDisplay == EGL_NO_DISPLAY) eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+	{
+		std::cout << "Failed to open an EGL display." << std::endl;
+		return false;
+	}
+	display = eglDisplay;
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cout << "EGL " << major << "." << minor << " can't make desktop GL contexts." << std::endl;
+		return false;
+	}
+	const EGLint configAttributes[] =
+	{
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0)
+	{
+		std::cout << "No EGL config for desktop GL." << std::endl;
+		return false;
+	}
+
+	//Compatibility profile, the ground grid is still drawn with glBegin
+	const EGLint contextAttributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+		EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR,
+		EGL_NONE
+	};
+	EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+	if (eglContext == EGL_NO_CONTEXT)
+	{
+		std::cout << "Failed to create an EGL context." << std::endl;
+		return false;
+	}
+	context = eglContext;
+
+	//Current with no surface at all, everything is drawn into our own framebuffer
+	if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+	{
+		std::cout << "EGL can't make a context current without a surface." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool HeadlessContext::createFramebuffer(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenRenderbuffers(1, &colour);
+	glBindRenderbuffer(GL_RENDERBUFFER, colour);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour);
+	//Depth and stencil like the window's, the stencil portals need it
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+	//A window's context starts with a viewport covering it, a surfaceless one with an empty one
+	glViewport(0, 0, width, height);
+	return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+bool HeadlessContext::saveImage(const std::string& fileName)
+{
+	std::vector<unsigned char> pixels(width * height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+	//GL's rows go bottom up, image files' top down
+	std::vector<unsigned char> flipped(pixels.size());
+	size_t row = width * 3;
+	for (int y = 0; y < height; y++) std::copy(&pixels[y * row], &pixels[y * row] + row, &flipped[(height - 1 - y) * row]);
+	return SOIL_save_image(fileName.c_str(), SOIL_SAVE_TYPE_BMP, width, height, 3, &flipped[0]) != 0;
+}
+
+bool writeBenchmarkReport(const std::string& fileName, const std::vector<double>& frameTimes, const Profiler& profiler)
+{
+	std::ostringstream report;
+	if (frameTimes.empty()) report << "No frames" << std::endl;
+	else
+	{
+		std::vector<double> sorted(frameTimes);
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0;
+		for (size_t i = 0; i < sorted.size(); i++) total += sorted[i];
+		size_t last = sorted.size() - 1;
+		report << "Frames\t" << sorted.size() << std::endl;
+		report << "Mean\t" << total / sorted.size() << " ms, " << 1000 * sorted.size() / total << " fps" << std::endl;
+		report << "Min\t" << sorted[0] << " ms" << std::endl;
+		report << "p50\t" << sorted[last * 50 / 100] << " ms" << std::endl;
+		report << "p95\t" << sorted[last * 95 / 100] << " ms" << std::endl;
+		report << "p99\t" << sorted[last * 99 / 100] << " ms" << std::endl;
+		report << "Max\t" << sorted[last] << " ms" << std::endl;
+	}
+	profiler.print(report);
+
+	std::cout << report.str();
+	std::ofstream file(fileName.c_str());
+	file << report.str();
+	return (bool)file;
+}
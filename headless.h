@@ -0,0 +1,43 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "profiler.h"
+
+//A GL context with no window or display server, through EGL's surfaceless platform, so the benchmark runs on build
+//machines without a GPU under Mesa's llvmpipe. There's no backbuffer, a framebuffer of the window's size stands in
+//for it. Only built into the headless target, which links EGL.
+class HeadlessContext
+{
+protected:
+	void* display; //EGLDisplay and EGLContext, kept opaque so including this doesn't pull in EGL
+	void* context;
+	GLuint framebuffer, colour, depth;
+	int width, height;
+
+	//Owns the context, so not copyable
+	HeadlessContext(const HeadlessContext&);
+	HeadlessContext& operator=(const HeadlessContext&);
+
+public:
+	HeadlessContext();
+	~HeadlessContext();
+
+	//Make a compatibility context current on this thread, false if EGL can't. Call glewInit() next, then createFramebuffer().
+	bool create();
+	//The stand in for the backbuffer, with a depth and stencil buffer
+	bool createFramebuffer(int width, int height);
+	GLuint getFramebuffer() const { return framebuffer; }
+
+	//Write what's in the framebuffer out as a bitmap
+	bool saveImage(const std::string& fileName);
+};
+
+//Frame time percentiles and every profiler scope, to the console and to fileName. frameTimes are in milliseconds.
+bool writeBenchmarkReport(const std::string& fileName, const std::vector<double>& frameTimes, const Profiler& profiler);
+
+#endif // HEADLESS_H
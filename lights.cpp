@@ -0,0 +1,253 @@
+#include "lights.h"
+
+#include <iostream>
+#include <math.h>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LIGHTS_SSE
+#include <xmmintrin.h>
+#endif
+
+//Brightness, after 1/d^2 falloff, below which a light is treated as not reaching
+const float LIGHT_CUTOFF = 0.02f;
+
+float lightRadius(const glm::vec3& colour)
+{
+	float brightest = colour.x > colour.y ? colour.x : colour.y;
+	brightest = brightest > colour.z ? brightest : colour.z;
+	return sqrtf(brightest / LIGHT_CUTOFF);
+}
+
+void bindLightTextures(GLuint program)
+{
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "lightData"), UNIT_LIGHT_DATA);
+	glUniform1i(glGetUniformLocation(program, "clusterRanges"), UNIT_CLUSTER_RANGES);
+	glUniform1i(glGetUniformLocation(program, "lightIndices"), UNIT_LIGHT_INDICES);
+}
+
+LightManager::LightManager(unsigned int threadCount) : pool(threadCount)
+{
+	lastEntries = 0;
+	warnedVisible = false;
+	slicesLeft = 0;
+	clusterLights.resize(CLUSTER_COUNT * MAX_CLUSTER_LIGHTS);
+	clusterCounts.resize(CLUSTER_COUNT);
+	clusterRanges.resize(CLUSTER_COUNT * 2);
+
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	glGenBuffers(3, buffers);
+	glGenTextures(3, textures);
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightManager::~LightManager()
+{
+	glDeleteTextures(3, textures);
+	glDeleteBuffers(3, buffers);
+}
+
+//Every light's position in view space, four at a time
+void LightManager::transformLights(const glm::mat4& view)
+{
+	size_t count = lights.size();
+	size_t padded = (count + 3) & ~(size_t)3;
+	worldX.resize(padded); worldY.resize(padded); worldZ.resize(padded); worldRadius.resize(padded);
+	viewX.resize(padded); viewY.resize(padded); viewZ.resize(padded);
+	for (size_t i = 0; i < padded; i++)
+	{
+		bool real = i < count;
+		worldX[i] = real ? lights[i].position.x : 0;
+		worldY[i] = real ? lights[i].position.y : 0;
+		worldZ[i] = real ? lights[i].position.z : 0;
+		worldRadius[i] = real ? lights[i].radius : 0; //Padding never reaches anything
+	}
+
+#ifdef LIGHTS_SSE
+	__m128 m[4][3];
+	for (int c = 0; c < 4; c++)
+	{
+		for (int r = 0; r < 3; r++) m[c][r] = _mm_set1_ps(view[c][r]);
+	}
+	for (size_t i = 0; i < padded; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&worldX[i]), y = _mm_loadu_ps(&worldY[i]), z = _mm_loadu_ps(&worldZ[i]);
+		__m128 out[3];
+		for (int r = 0; r < 3; r++)
+		{
+			out[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][r], x), _mm_mul_ps(m[1][r], y)), _mm_add_ps(_mm_mul_ps(m[2][r], z), m[3][r]));
+		}
+		_mm_storeu_ps(&viewX[i], out[0]);
+		_mm_storeu_ps(&viewY[i], out[1]);
+		_mm_storeu_ps(&viewZ[i], out[2]);
+	}
+#else
+	for (size_t i = 0; i < padded; i++)
+	{
+		glm::vec4 p = view * glm::vec4(worldX[i], worldY[i], worldZ[i], 1);
+		viewX[i] = p.x;
+		viewY[i] = p.y;
+		viewZ[i] = p.z;
+	}
+#endif
+}
+
+static int depthSlice(float depth, float zScale)
+{
+	if (depth <= CLUSTER_NEAR) return 0;
+	int slice = (int)(logf(depth / CLUSTER_NEAR) * zScale);
+	return slice < CLUSTER_Z - 1 ? slice : CLUSTER_Z - 1;
+}
+
+static int clampTile(float ndc, int tiles)
+{
+	int tile = (int)floorf((ndc + 1) / 2 * tiles);
+	return tile < 0 ? 0 : (tile >= tiles ? tiles - 1 : tile);
+}
+
+//Which clusters each light's sphere can touch, dropping lights that are off screen
+void LightManager::findRanges(const glm::mat4& proj)
+{
+	float zScale = CLUSTER_Z / logf(CLUSTER_FAR / CLUSTER_NEAR);
+	visibleLights.clear();
+	ranges.clear();
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		float radius = worldRadius[i];
+		float nearDepth = -viewZ[i] - radius;
+		float farDepth = -viewZ[i] + radius;
+		if (radius <= 0 || farDepth <= 0) continue; //Behind the camera
+
+		//Screen rectangle of the sphere's view space box, the whole screen if the box reaches behind the camera
+		float left = -1, right = 1, bottom = -1, top = 1;
+		bool behind = nearDepth <= 0;
+		if (!behind)
+		{
+			left = bottom = 1e30f;
+			right = top = -1e30f;
+			for (int corner = 0; corner < 8 && !behind; corner++)
+			{
+				glm::vec4 p(viewX[i] + ((corner & 1) ? radius : -radius), viewY[i] + ((corner & 2) ? radius : -radius), viewZ[i] + ((corner & 4) ? radius : -radius), 1);
+				glm::vec4 clip = proj * p;
+				if (clip.w <= 0)
+				{
+					behind = true;
+					break;
+				}
+				float x = clip.x / clip.w, y = clip.y / clip.w;
+				left = x < left ? x : left;
+				right = x > right ? x : right;
+				bottom = y < bottom ? y : bottom;
+				top = y > top ? y : top;
+			}
+			if (behind)
+			{
+				left = bottom = -1;
+				right = top = 1;
+			}
+		}
+		if (right < -1 || left > 1 || top < -1 || bottom > 1) continue;
+
+		if (visibleLights.size() == (size_t)MAX_VISIBLE_LIGHTS)
+		{
+			if (!warnedVisible) std::cout << "WARNING: more than " << MAX_VISIBLE_LIGHTS << " lights in view, the rest are left out" << std::endl;
+			warnedVisible = true;
+			break;
+		}
+		visibleLights.push_back((int)i);
+		ranges.push_back(clampTile(left, CLUSTER_X));
+		ranges.push_back(clampTile(right, CLUSTER_X));
+		ranges.push_back(clampTile(bottom, CLUSTER_Y));
+		ranges.push_back(clampTile(top, CLUSTER_Y));
+		ranges.push_back(depthSlice(nearDepth, zScale));
+		ranges.push_back(depthSlice(farDepth, zScale));
+	}
+}
+
+//Fill the light lists of every cluster in slices zBegin..zEnd-1. Slices don't share clusters, so these can run side by side.
+void LightManager::binSlices(int zBegin, int zEnd)
+{
+	for (int c = zBegin * CLUSTER_X * CLUSTER_Y; c < zEnd * CLUSTER_X * CLUSTER_Y; c++) clusterCounts[c] = 0;
+	for (size_t k = 0; k < visibleLights.size(); k++)
+	{
+		const int* range = &ranges[k * 6];
+		int z0 = range[4] > zBegin ? range[4] : zBegin;
+		int z1 = range[5] < zEnd - 1 ? range[5] : zEnd - 1;
+		for (int z = z0; z <= z1; z++)
+		{
+			for (int y = range[2]; y <= range[3]; y++)
+			{
+				for (int x = range[0]; x <= range[1]; x++)
+				{
+					int c = (z * CLUSTER_Y + y) * CLUSTER_X + x;
+					if (clusterCounts[c] < MAX_CLUSTER_LIGHTS) clusterLights[c * MAX_CLUSTER_LIGHTS + clusterCounts[c]++] = (unsigned short)k;
+				}
+			}
+		}
+	}
+}
+
+glm::vec4 LightManager::cluster(const glm::mat4& view, const glm::mat4& proj, int width, int height)
+{
+	transformLights(view);
+	findRanges(proj);
+
+	//A handful of lights isn't worth handing out
+	int tasks = visibleLights.size() >= 32 ? (int)pool.size() + 1 : 1;
+	if (tasks > CLUSTER_Z) tasks = CLUSTER_Z;
+	slicesLeft = tasks - 1;
+	for (int t = 1; t < tasks; t++)
+	{
+		int zBegin = CLUSTER_Z * t / tasks, zEnd = CLUSTER_Z * (t + 1) / tasks;
+		pool.submit([this, zBegin, zEnd]() {
+			binSlices(zBegin, zEnd);
+			slicesLeft--;
+		});
+	}
+	binSlices(0, CLUSTER_Z / tasks);
+	while (slicesLeft > 0) std::this_thread::yield();
+
+	//Pack the lists end to end
+	lightIndices.clear();
+	for (int c = 0; c < CLUSTER_COUNT; c++)
+	{
+		clusterRanges[c * 2] = (GLuint)lightIndices.size();
+		clusterRanges[c * 2 + 1] = clusterCounts[c];
+		lightIndices.insert(lightIndices.end(), &clusterLights[c * MAX_CLUSTER_LIGHTS], &clusterLights[c * MAX_CLUSTER_LIGHTS] + clusterCounts[c]);
+	}
+	lastEntries = (int)lightIndices.size();
+	if (lightIndices.empty()) lightIndices.push_back(0); //Buffers can't be empty
+
+	lightData.resize(visibleLights.empty() ? 2 : visibleLights.size() * 2);
+	for (size_t k = 0; k < visibleLights.size(); k++)
+	{
+		int i = visibleLights[k];
+		lightData[k * 2] = glm::vec4(viewX[i], viewY[i], viewZ[i], lights[i].radius);
+		lightData[k * 2 + 1] = glm::vec4(lights[i].colour, 0);
+	}
+
+	//Fresh storage each view, so earlier views still drawing keep what they were given
+	const void* data[3] = { &lightData[0], &clusterRanges[0], &lightIndices[0] };
+	size_t bytes[3] = { lightData.size() * sizeof(glm::vec4), clusterRanges.size() * sizeof(GLuint), lightIndices.size() * sizeof(GLuint) };
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, bytes[i], data[i], GL_STREAM_DRAW);
+		glActiveTexture(GL_TEXTURE0 + UNIT_LIGHT_DATA + i);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	float zScale = CLUSTER_Z / logf(CLUSTER_FAR / CLUSTER_NEAR);
+	return glm::vec4(float(CLUSTER_X) / width, float(CLUSTER_Y) / height, zScale, -logf(CLUSTER_NEAR) * zScale);
+}
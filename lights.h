@@ -0,0 +1,94 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include <atomic>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+
+#include "assetloader.h"
+
+//View space cluster grid lights are binned into, matched in shader.frag.
+//x and y split the viewport into tiles, z splits depth exponentially between CLUSTER_NEAR and CLUSTER_FAR.
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+const float CLUSTER_NEAR = 0.5f; //Anything closer is in the first slice
+const float CLUSTER_FAR = 1000.0f;
+const int MAX_CLUSTER_LIGHTS = 128; //Lights past this in one cluster are left out of it
+const int MAX_VISIBLE_LIGHTS = 65536; //Lights past this in one view are left out, so clusters can index them with unsigned shorts
+
+//Texture units the light buffers are bound to, unit 0 is the material's texture
+enum light_texture_unit_t { UNIT_LIGHT_DATA = 1, UNIT_CLUSTER_RANGES, UNIT_LIGHT_INDICES };
+
+struct PointLight
+{
+	glm::vec3 position; //World space
+	glm::vec3 colour;   //Intensity, falls off with 1/d^2
+	float radius;       //Where it is faded out completely
+};
+
+//How far a light of this colour reaches before it's too dim to matter
+float lightRadius(const glm::vec3& colour);
+
+//Point a freshly linked program's light buffer samplers at their texture units
+void bindLightTextures(GLuint program);
+
+//Any number of point lights, binned into the cluster grid for each view so each fragment only loops over the
+//lights that can reach it. Binning runs over depth slices on a few threads, with lights moved into view space
+//four at a time.
+class LightManager
+{
+protected:
+	std::vector<PointLight> lights;
+
+	//Per view scratch
+	std::vector<float> worldX, worldY, worldZ, worldRadius; //Padded to a multiple of 4
+	std::vector<float> viewX, viewY, viewZ;
+	std::vector<int> ranges;                    //x0 x1 y0 y1 z0 z1 of the clusters each visible light touches
+	std::vector<int> visibleLights;             //Indices into lights
+	std::vector<unsigned short> clusterLights;  //MAX_CLUSTER_LIGHTS slots per cluster, indices into visibleLights
+	std::vector<unsigned short> clusterCounts;
+
+	//What gets uploaded
+	std::vector<glm::vec4> lightData;           //View space position and radius, then colour, per visible light
+	std::vector<GLuint> clusterRanges;          //First index and count per cluster
+	std::vector<GLuint> lightIndices;
+
+	GLuint buffers[3];  //Light data, cluster ranges, light indices
+	GLuint textures[3];
+	int lastEntries;    //Cluster-light pairs in the last view
+	bool warnedVisible; //Already said MAX_VISIBLE_LIGHTS was hit
+
+	ThreadPool pool;
+	std::atomic<int> slicesLeft;
+
+	void transformLights(const glm::mat4& view);
+	void findRanges(const glm::mat4& proj);
+	void binSlices(int zBegin, int zEnd);
+
+	//Owns GL objects, so not copyable
+	LightManager(const LightManager&);
+	LightManager& operator=(const LightManager&);
+
+public:
+	//0 threads means one per core, leaving one for the GL thread
+	LightManager(unsigned int threadCount = 0);
+	~LightManager();
+
+	int add(const PointLight& light) { lights.push_back(light); return (int)lights.size() - 1; }
+	PointLight& get(int index) { return lights[index]; }
+	size_t size() const { return lights.size(); }
+	void clear() { lights.clear(); }
+
+	//Bin the lights for a view drawn into a width*height viewport, upload the result and bind it.
+	//Returns the cluster vector for the view's PassBlock.
+	glm::vec4 cluster(const glm::mat4& view, const glm::mat4& proj, int width, int height);
+
+	int getLastEntries() const { return lastEntries; }
+};
+
+#endif // LIGHTS_H
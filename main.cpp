@@ -1,930 +1,812 @@
-//NOTE, up is +ve Z axis.
-
-//Include GLEW  
-//#define GLEW_STATIC
-
-//Library for loading textures (Simple OpenGL Image Library)
-#include <SOIL.h>
-
-#include <GL/glew.h>  
-
-#include<iostream> //cout
-#include <fstream> //fstream
-#include <vector> 
-#include <ctime> 
-
-//Include GLFW  
-#include <GLFW/glfw3.h>  
-
-//Include the standard C++ headers  
-#include <stdio.h>  
-#include <stdlib.h> 
-
-//Include matrix libraries
-#include "glm/glm.hpp"
-#include "glm/gtc/matrix_transform.hpp"
-#include "glm/gtc/matrix_inverse.hpp"
-#include "glm/gtc/type_ptr.hpp"
-
-//#include <assimp/cimport.h>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-#include <assimp/Importer.hpp>
-
-//Our includes
-#include "camera.h"
-#include <btBulletDynamicsCommon.h>
-
-//Constants and globals
-const int window_width = 1024;
-const int window_height = 768;
-int meshSelect = -99; // which mesh/object is currently selected
-float grabDist;
-float grabScale = 1;
-Camera *camera; //For key modification
-btDiscreteDynamicsWorld* dynamicsWorld; //For raytrace on keypress
-int shaderMode = 0;
-enum collision_t { PLANE, BOX, SPHERE };
-
-										//Define an error callback  
-static void error_callback(int error, const char* description)
-{
-	fputs(description, stderr);
-	_fgetchar();
-}
-
-void printUnderCamera()
-{
-	glm::vec3 camPt = camera->getPosition();
-	glm::vec3 endPt = camPt + camera->getRotVec()*1000.0f;
-	btCollisionWorld::ClosestRayResultCallback RayCallback(
-		btVector3(camPt.x, camPt.y, camPt.z),
-		btVector3(endPt.x, endPt.y, endPt.z)
-	);
-	dynamicsWorld->rayTest(
-		btVector3(camPt.x, camPt.y, camPt.z),
-		btVector3(endPt.x, endPt.y, endPt.z),
-		RayCallback
-	);
-
-	if (RayCallback.hasHit()) {
-		if (meshSelect == (int)RayCallback.m_collisionObject->getUserIndex())
-		{
-			meshSelect = -99;
-		}
-		else
-		{
-			btVector3 objO = RayCallback.m_collisionObject->getWorldTransform().getOrigin();
-			grabDist = sqrt((objO.x() - camPt.x)*(objO.x() - camPt.x) + (objO.y() - camPt.y)*(objO.y() - camPt.y) + (objO.z() - camPt.z)*(objO.z() - camPt.z));
-			grabScale = RayCallback.m_collisionObject->getCollisionShape()->getLocalScaling().x();
-			meshSelect = (int)RayCallback.m_collisionObject->getUserIndex();
-		}
-		std::cout << "mesh " << meshSelect << std::endl;
-		std::cout << "dist " << grabDist << std::endl;
-	}
-	else
-	{
-		std::cout << "background" << std::endl;
-	}
-}
-
-//Define the key input callback  
-static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
-{
-	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
-		glfwSetWindowShouldClose(window, GL_TRUE);
-	else
-	{
-		if (key == GLFW_KEY_E && action == GLFW_PRESS)
-		{
-			//Debug data dump
-			glm::vec3 temp = camera->getPosition() + camera->getRotVec();
-			std::cout << camera->getXPos() << "\t" << camera->getYPos() << "\t" << camera->getZPos() << "\t" << std::endl;
-			std::cout << temp.x << "\t" << temp.y << "\t" << temp.z << std::endl;
-
-		}
-		if (key == GLFW_KEY_Q && action == GLFW_PRESS)
-		{
-			camera->altLock = !camera->altLock;
-		}
-		if (key == GLFW_KEY_R && action == GLFW_PRESS)
-		{
-			//Do a raytrace through the camera.
-			printUnderCamera();
-		}
-		if (key == GLFW_KEY_F && action == GLFW_PRESS)
-		{
-			grabScale = grabScale * 5/4;
-			grabDist = grabDist * 5/4;
-		}
-		if (key == GLFW_KEY_G && action == GLFW_PRESS)
-		{
-			grabScale = grabScale * 4/5;
-			grabDist = grabDist * 4/5;
-		}
-		if (key == GLFW_KEY_T && action == GLFW_PRESS)
-		{
-			grabScale = 1;
-			grabDist = 5;
-		}
-		if (key == GLFW_KEY_V && action == GLFW_PRESS)
-		{
-			shaderMode = (shaderMode+1)%4;
-		}
-
-		camera->handleKeypress(key, action);
-	}
-
-}
-
-void handleMouseMove(GLFWwindow *window, double mouseX, double mouseY)
-{
-	camera->handleMouseMove(window, mouseX, mouseY);
-}
-
-bool getShaderCompileStatus(GLuint shader) {
-	//Get status
-	GLint status;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-	if (status == GL_TRUE) {
-		return true;
-	}
-	else {
-		//Get log
-		char buffer[512];
-		glGetShaderInfoLog(shader, 512, NULL, buffer);
-		std::cout << buffer << std::endl;
-		return false;
-	}
-}
-
-static void loadMesh(std::string file_name, std::vector<GLfloat>& data, int& number_of_elements) {
-	Assimp::Importer importer;
-	importer.ReadFile(file_name, aiProcessPreset_TargetRealtime_MaxQuality);
-	const aiScene* scene = importer.GetScene();
-	number_of_elements = 0;
-
-	if (scene) {
-		if (scene->HasMeshes()) {
-			for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-				const struct aiMesh* mesh = scene->mMeshes[i];
-				for (unsigned int t = 0; t < mesh->mNumFaces; ++t) {
-					const struct aiFace* face = &mesh->mFaces[t];
-					number_of_elements += face->mNumIndices;
-					if (face->mNumIndices != 3) {
-						std::cout << "WARNING " << __FILE__ << " : " << __LINE__ << " - faces are not triangulated" << std::endl;
-					}
-					for (unsigned int j = 0; j < face->mNumIndices; j++) {
-						int index = face->mIndices[j];
-
-						//Vertex positions
-						data.push_back(mesh->mVertices[index].x); data.push_back(mesh->mVertices[index].z); data.push_back(mesh->mVertices[index].y);
-
-						//Vertex normals
-						if (mesh->mNormals != NULL) {
-							//If we have normals, push them back next
-							data.push_back(mesh->mNormals[index].x); data.push_back(mesh->mNormals[index].z); data.push_back(mesh->mNormals[index].y);
-						}
-						else {
-							//If not, just set to zero, but warn the user as this will likely make the lighting null
-							data.push_back(0); data.push_back(0); data.push_back(0);
-							std::cout << "WARNING: No normals loaded for mesh " << file_name << std::endl;
-						}
-
-						//Vertex colours
-						if (mesh->mColors[0] != NULL) {
-							//If we have colours, append them
-							data.push_back(mesh->mColors[index]->r); data.push_back(mesh->mColors[index]->g); data.push_back(mesh->mColors[index]->b);
-						}
-						else {
-							//If no colours, push back white
-							data.push_back(1); data.push_back(1); data.push_back(1);
-						}
-
-						//Texture coords
-						if (mesh->mTextureCoords[0] != NULL) {
-							//Push back textures
-							data.push_back(mesh->mTextureCoords[0][index].x); data.push_back(1 - mesh->mTextureCoords[0][index].y);
-						}
-						else {
-							data.push_back(0); data.push_back(0);
-						}
-					}
-				}
-			}
-		}
-	}
-	else {
-		std::cout << "No object found! - Looking for " << file_name << std::endl;
-	}
-}
-
-void drawGround(float groundLevel)
-{
-	GLfloat extent = 600.0f; // How far on the Z-Axis and X-Axis the ground extends
-	GLfloat stepSize = 10.0f;  // The size of the separation between points
-	glColor3b(255, 255, 255);	//Set colour, probably broken.
-
-								// Draw our ground grid
-	glBegin(GL_LINES);
-	for (GLint loop = -extent; loop < extent; loop += stepSize)
-	{
-		// Draw lines along Y-Axis
-		glVertex3f(loop, extent, groundLevel);
-		glVertex3f(loop, -extent, groundLevel);
-
-		// Draw lines across X-Axis
-		glVertex3f(-extent, loop, groundLevel);
-		glVertex3f(extent, loop, groundLevel);
-	}
-	glEnd();
-}
-
-GLFWwindow* makeWindow()
-{
-	//Declare a window object  
-	GLFWwindow* window;
-
-	//Create a window and create its OpenGL context
-	window = glfwCreateWindow(window_width, window_height, "Perspective", NULL, NULL);
-
-	//If the window couldn't be created  
-	if (!window)
-	{
-		fprintf(stderr, "Failed to open GLFW window.\n");
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-
-	//This function makes the context of the specified window current on the calling thread.   
-	glfwMakeContextCurrent(window);
-	return window;
-}
-
-GLFWwindow* init()
-//Initialises GLFW, GLEW and returns the window object
-{
-	//Set the error callback  
-	glfwSetErrorCallback(error_callback);
-
-	//Initialize GLFW  
-	if (!glfwInit())
-	{
-		exit(EXIT_FAILURE);
-	}
-
-	//Set the GLFW window creation hints - these are optional  
-	//glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); //Request a specific OpenGL version  
-	//glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2); //Request a specific OpenGL version  
-	//glfwWindowHint(GLFW_SAMPLES, 16); //Request 4x antialiasing  
-	//glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);  
-
-	GLFWwindow* window = makeWindow();
-
-	//Sets the key callback  
-	glfwSetKeyCallback(window, key_callback);
-	glfwSetCursorPosCallback(window, handleMouseMove);
-
-	//Initialize GLEW  
-	glewExperimental = GL_TRUE;
-	GLenum err = glewInit();
-
-	//If GLEW hasn't initialized  
-	if (err != GLEW_OK)
-	{
-		fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
-		exit(-1);
-	}
-	return window;
-}
-
-int loadVertex(std::string name, GLuint vao, GLuint buffer)
-{
-	//create Vertex array object
-	glBindVertexArray(vao);
-
-	//Load mesh with ASSIMP
-	std::vector<GLfloat> data;
-	int numberOfVertices = 0;
-	loadMesh(name, data, numberOfVertices);
-
-	if (numberOfVertices != 0) {
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * data.size(), &data[0], GL_STATIC_DRAW);
-	}
-	else {
-		std::cout << "Model Empty!!" << std::endl;
-	}
-	return numberOfVertices;
-}
-
-GLuint makeShader(char vert[], char frag[])
-{
-	//Example:load shader source file
-	std::ifstream in(vert);
-	std::string contents((std::istreambuf_iterator<char>(in)),
-		std::istreambuf_iterator<char>());
-	const char* vertSource = contents.c_str();
-
-	//Example: compile a shader source file for vertex shading
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertSource, NULL);
-	glCompileShader(vertexShader);
-
-	getShaderCompileStatus(vertexShader);
-
-	//load and compile fragment shader shader.frag
-	std::ifstream in2(frag);
-	std::string contents2((std::istreambuf_iterator<char>(in2)),
-		std::istreambuf_iterator<char>());
-	const char* fragSource = contents2.c_str();
-
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragSource, NULL);
-	glCompileShader(fragmentShader);
-
-	getShaderCompileStatus(fragmentShader);
-
-	//link shaders into a program
-	GLuint shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glBindFragDataLocation(shaderProgram, 0, "outColor");
-	glLinkProgram(shaderProgram);
-	glUseProgram(shaderProgram);
-	return shaderProgram;
-}
-
-void linkVertexToShader(GLuint shaderProgram)
-{
-	//link vertex data to shader
-	GLint posAttrib = glGetAttribLocation(shaderProgram, "position");
-	glVertexAttribPointer(posAttrib,                //buffer identifier
-		3,                        //How many data points to read
-		GL_FLOAT,                 //Data type
-		GL_FALSE,                 //Whether or not to clamp values between -1,1
-		11 * sizeof(float),        //Stride (byte offset between consecutive values)
-		0                         //pointer to first attribute (see below for better examples)
-	);
-	glEnableVertexAttribArray(posAttrib);
-
-	GLint colourAttrib = glGetAttribLocation(shaderProgram, "colour");
-	glVertexAttribPointer(colourAttrib, 3, GL_FLOAT, GL_TRUE, 11 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(colourAttrib);
-
-	GLint textureAttrib = glGetAttribLocation(shaderProgram, "texcoord");
-	glVertexAttribPointer(textureAttrib, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(9 * sizeof(float)));
-	glEnableVertexAttribArray(textureAttrib);
-
-	GLint normalAttrib = glGetAttribLocation(shaderProgram, "normal");
-	glVertexAttribPointer(normalAttrib, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(normalAttrib);
-
-}
-
-GLuint loadTexture(char* name)
-{
-	//Create texture buffer:
-	GLuint tex;
-	glGenTextures(1, &tex);
-	glBindTexture(GL_TEXTURE_2D, tex);
-
-	//Load image
-	int width, height;
-	unsigned char* image =
-		SOIL_load_image(name, &width, &height, 0, SOIL_LOAD_RGB);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-		GL_UNSIGNED_BYTE, image);
-	SOIL_free_image_data(image);
-
-	//Set sampler parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	return tex;
-}
-
-void loadTextures(GLuint texArray[], int size, char* stringList[])
-{
-	for (int i = 0; i < size; i++)
-	{
-		texArray[i] = loadTexture(stringList[i]);
-	}
-}
-
-void loadVerticies(GLuint meshArray[], GLuint buffArray[], int numVArray[], int size, char* meshList[])
-{
-	for (int i = 0; i < size; i++)
-	{
-		glGenVertexArrays(1, &meshArray[i]);
-		glGenBuffers(1, &buffArray[i]);
-		numVArray[i] = loadVertex(meshList[i], meshArray[i], buffArray[i]);
-	}
-
-
-}
-
-void linkToShader(int size, GLuint* shaderProg, GLuint meshArray[], GLuint buffArray[])
-{
-	for (int i = 0; i < size; i++)
-	{
-		glBindVertexArray(meshArray[i]);
-		glBindBuffer(GL_ARRAY_BUFFER, buffArray[i]);
-		linkVertexToShader(*shaderProg);
-	}
-}
-
-void initPhysics()
-{
-	//---Bullet physics setup---
-	// Build the broadphase
-	btBroadphaseInterface* broadphase = new btDbvtBroadphase();
-
-	// Set up the collision configuration and dispatcher
-	btDefaultCollisionConfiguration* collisionConfiguration = new btDefaultCollisionConfiguration();
-	btCollisionDispatcher* dispatcher = new btCollisionDispatcher(collisionConfiguration);
-
-	// The actual physics solver
-	btSequentialImpulseConstraintSolver* solver = new btSequentialImpulseConstraintSolver;
-
-	// The world.
-	dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration);
-	dynamicsWorld->setGravity(btVector3(0, 0, -9.8));
-}
-
-btRigidBody* makePlane(btCollisionShape* groundShape, glm::vec3 position)
-{
-	btVector3 positionBT = btVector3(position.x, position.y, position.z);
-	btDefaultMotionState* groundMotionState = new btDefaultMotionState(btTransform(btQuaternion(0, 0, 0, 1), positionBT));
-	btRigidBody::btRigidBodyConstructionInfo groundRigidBodyCI(0, groundMotionState, groundShape, btVector3(0, 0, 0));
-	btRigidBody* groundRigidBody = new btRigidBody(groundRigidBodyCI);
-	return groundRigidBody;
-}
-
-btRigidBody* makeBox(btCollisionShape* boxShape, glm::vec3 position, glm::quat rotation, float mass)
-{
-	btVector3 positionBT = btVector3(position.x, position.y, position.z);
-	btQuaternion rotationBT = btQuaternion(rotation.x, rotation.y, rotation.z);
-	btVector3 fallInertia(0, 0, 0);
-	boxShape -> calculateLocalInertia(mass, fallInertia);
-	btDefaultMotionState* motionState = new btDefaultMotionState(btTransform(rotationBT, positionBT));
-	btRigidBody::btRigidBodyConstructionInfo rigidBodyBox1CI(mass,motionState,boxShape,fallInertia);
-	btRigidBody* rigidBodyBox = new btRigidBody(rigidBodyBox1CI);
-	return rigidBodyBox;
-}
-
-btRigidBody* makePhysObject(collision_t type, glm::vec3 position, glm::quat rotation, glm::vec3 size, float mass, int index)
-{
-	btCollisionShape* shape;
-	btQuaternion rotationBT = btQuaternion(rotation.x, rotation.y, rotation.z, rotation.w);
-	btVector3 sizeBT = btVector3(size.x, size.y, size.z);
-	btRigidBody* tempRB;
-	switch (type)
-	{
-	case PLANE:
-		shape = new btStaticPlaneShape(quatRotate(rotationBT,btVector3(0, 0, 1)), 1);
-		tempRB = makePlane(shape, position);
-		break;
-	case BOX:
-		shape = new btBoxShape(sizeBT);
-		tempRB = makeBox(shape, position, rotation, mass);
-		break;
-	case SPHERE:
-		shape = new btSphereShape(sizeBT.x()); //Bad, but eh
-		tempRB = makeBox(shape, position, rotation, mass);
-		break;
-	}
-	tempRB->setUserIndex(index);
-	dynamicsWorld->addRigidBody(tempRB);
-	return tempRB;
-}
-
-void drawObject(glm::vec3 position, float angle, glm::vec3 axis, glm::vec3 scale, GLuint tex, GLuint mesh, GLuint buff, int numV, GLint uniModel)
-{
-	glm::mat4 zero;
-	glm::mat4 mCurrent;
-	mCurrent = glm::translate(zero, position);
-	mCurrent = glm::rotate(mCurrent, angle, axis);
-	mCurrent = glm::scale(mCurrent, scale);
-	glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(mCurrent));
-	glBindVertexArray(mesh);
-	glBindBuffer(GL_ARRAY_BUFFER, buff);
-	glBindTexture(GL_TEXTURE_2D, tex);
-	glDrawArrays(GL_TRIANGLES, 0, numV);
-
-}
-
-void drawPhysObject(btRigidBody* rigid, GLuint tex, GLuint mesh, GLuint buff, int numV, GLint uniModel)
-{
-	btTransform btf;
-	glm::vec3 bTrans;//Translate
-	glm::vec3 bAxis; //Rotate axis
-	float bAngl;	 //Rotate amount
-	glm::vec3 bScale;//Scaling factors
-	rigid->getMotionState()->getWorldTransform(btf);
-	if (rigid->getUserIndex() == meshSelect)
-	{
-		bTrans = camera->getPosition() + camera->getRotVec()*grabDist; //DISTANCE HERE
-		
-		rigid->setWorldTransform(btTransform(btf.getRotation(), btVector3(bTrans.x, bTrans.y, bTrans.z)));
-		rigid->getCollisionShape()->setLocalScaling(btVector3(1,1,1)*grabScale);
-		rigid->setLinearVelocity(btVector3(0, 0, 0));
-		rigid->setAngularVelocity(btVector3(0, 0, 0));
-		rigid->clearForces();
-		rigid->activate();
-	}
-	else
-	{
-		bTrans = glm::vec3(btf.getOrigin().getX(), btf.getOrigin().getY(), btf.getOrigin().getZ());
-	}
-	bAxis = glm::vec3(btf.getRotation().getAxis().getX(), btf.getRotation().getAxis().getY(), btf.getRotation().getAxis().getZ());
-	bAngl = btf.getRotation().getAngle()*180.0 / 3.141592654;
-	bScale = glm::vec3(rigid->getCollisionShape()->getLocalScaling().x(), rigid->getCollisionShape()->getLocalScaling().y(), rigid->getCollisionShape()->getLocalScaling().z());
-
-	drawObject(bTrans, bAngl, bAxis, bScale, tex, mesh, buff, numV, uniModel);
-	
-}
-
-int main(void)
-{
-	GLFWwindow* window = init();
-	
-	//==================================
-	//        Load vertex data
-	//==================================
-	const int numMeshes = 5;
-	//Hardcoded list of mesh names
-	char* meshList[numMeshes];
-	meshList[0] = "cube.obj";
-	meshList[1] = "Ball.obj";
-	meshList[2] = "floor.obj";
-	meshList[3] = "thingy.obj";
-	meshList[4] = "plate.obj";
-
-	GLuint meshArray[numMeshes];
-	GLuint buffArray[numMeshes];
-	int numVArray[numMeshes];
-
-	loadVerticies(meshArray, buffArray, numVArray, numMeshes, meshList);
-
-	//==================================
-	//     Compile and Link Shaders
-	//==================================
-	GLuint shaderProgram = makeShader("shader.vert", "shader.frag");
-	GLuint modeU = glGetUniformLocation(shaderProgram, "mode");
-
-	glUniform1i(modeU, 0);
-	//==================================
-	//    Link Vertex Data to Shaders
-	//==================================
-
-	linkToShader(numMeshes, &shaderProgram, meshArray, buffArray);
-
-	//==================================
-	//          Load Texture
-	//==================================
-	//Hardcoded list of texture names
-	char* texList[3];
-	texList[0] = "kitten.png";
-	texList[1] = "rocks.jpg";
-	texList[2] = "thingy.png";
-	//Texture array which is then fed into the binds
-	GLuint texArray[3];
-	loadTextures(texArray, 3, texList);
-
-	//==================================
-	//          Physics Setup
-	//==================================
-
-	initPhysics();
-	//Array of Rigidbodies
-	btRigidBody* rigidBodyArr[6];
-	rigidBodyArr[0] = makePhysObject(PLANE, glm::vec3(0, 0, -1), glm::quat(0,0,0,1), glm::vec3(0,0,0), 0.0, 0);
-	rigidBodyArr[1] = makePhysObject(BOX, glm::vec3(25,0,10), glm::quat(0,0,0,1), glm::vec3(0.5,0.5,0.5), 1.0, 1);
-	rigidBodyArr[2] = makePhysObject(SPHERE, glm::vec3(24, 0, 15), glm::quat(0, 0, 0, 1), glm::vec3(1, 1, 1), 1.0, 2);
-	rigidBodyArr[3] = makePhysObject(BOX, glm::vec3(1,5.2,10),glm::quat(0.5,0.15,7,1),glm::vec3(0.5,0.5,0.5), 1.0, 3);
-	rigidBodyArr[4] = makePhysObject(BOX, glm::vec3(0, 0, 10), glm::quat(0, 0, 0, 1), glm::vec3(1, 1, 1), 1.0, 4);
-	rigidBodyArr[5] = makePhysObject(PLANE, glm::vec3(40, 0, 0), glm::quat(0, -1/sqrt(2), 0, 1/sqrt(2)), glm::vec3(0, 0, 0), 0.0, 5);
-	//--end of physics setup--
-
-	//=============
-	//Render to texture modification
-	//=============
-	// The framebuffer, which regroups 0, 1, or more textures, and 0 or 1 depth buffer.
-	GLuint screenFB;	//Screen Frame Buffer
-	GLuint screenTex;	//The texture we're going to render to
-	GLuint screenDB;	//Screen Depth Buffer
-	glGenFramebuffers(1, &screenFB);
-	glBindFramebuffer(GL_FRAMEBUFFER, screenFB);
-	glGenTextures(1, &screenTex);
-	glBindTexture(GL_TEXTURE_2D, screenTex);// "Bind" the newly created texture : all future texture functions will modify this texture
-	// Give an empty image to OpenGL ( the last "0" means "empty" )
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, window_width, window_height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	// The depth buffer
-	glGenRenderbuffers(1, &screenDB);
-	glBindRenderbuffer(GL_RENDERBUFFER, screenDB);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, window_width, window_height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, screenDB);
-	// Set "renderedTexture" as our colour attachement #0
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, screenTex, 0);
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)// Always check that our framebuffer is ok
-		return false;
-
-	// The fullscreen quad's FBO
-	static const GLfloat g_quad_vertex_buffer_data[] = 
-	{
-		-1.0f, -1.0f, 0.0f,
-		1.0f, -1.0f, 0.0f,
-		-1.0f,  1.0f, 0.0f,
-		-1.0f,  1.0f, 0.0f,
-		1.0f, -1.0f, 0.0f,
-		1.0f,  1.0f, 0.0f,
-	};
-	
-	GLuint quad_mesh;
-	glGenVertexArrays(1, &quad_mesh);
-	glBindVertexArray(quad_mesh);
-
-	GLuint quad_vertexbuffer;
-	glGenBuffers(1, &quad_vertexbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(g_quad_vertex_buffer_data), g_quad_vertex_buffer_data, GL_STATIC_DRAW);
-
-	// Create and compile our GLSL program from the shaders
-	GLuint fake_prog = makeShader("pass.vert", "pass.frag");
-	GLuint texID = glGetUniformLocation(fake_prog, "renderedTexture");
-	
-	//===================
-	//Portal Modification
-	//===================
-	//Define positions for both portals.
-	glm::vec3 port1Pos = glm::vec3(20, 10, 1);
-	glm::vec3 port1RAx = glm::vec3(0, 0, 1);
-	float     port1RAn = 00.0;
-	glm::vec3 port2Pos = glm::vec3(15, -10, 1);
-	glm::vec3 port2RAx = glm::vec3(0, 0, 1);
-	float     port2RAn = -90.0;
-	//Set up blank textures for the portals
-	GLuint whiteTex;
-	unsigned char white[3];
-	white[0] = 255;
-	white[1] = 255;
-	white[2] = 255;
-	glGenTextures(1, &whiteTex);
-	glBindTexture(GL_TEXTURE_2D, whiteTex);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, white);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	//Make new framebuffers and prepare to render to texture
-	GLuint p1FB;
-	GLuint p1Tex;	//The texture we're going to render to
-	GLuint p1DB;	//Screen Depth Buffer
-	glGenFramebuffers(1, &p1FB);
-	glBindFramebuffer(GL_FRAMEBUFFER, p1FB);
-	glGenTextures(1, &p1Tex);
-	glBindTexture(GL_TEXTURE_2D, p1Tex);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 2048, 2048, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glGenRenderbuffers(1, &p1DB);
-	glBindRenderbuffer(GL_RENDERBUFFER, p1DB);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, 2048, 2048);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, p1DB);
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, p1Tex, 0);
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)// Always check that our framebuffer is ok
-		return false;
-
-	GLuint p2FB;
-	GLuint p2Tex;	//The texture we're going to render to
-	GLuint p2DB;	//Screen Depth Buffer
-	glGenFramebuffers(1, &p2FB);
-	glBindFramebuffer(GL_FRAMEBUFFER, p2FB);
-	glGenTextures(1, &p2Tex);
-	glBindTexture(GL_TEXTURE_2D, p2Tex);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 2048, 2048, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glGenRenderbuffers(1, &p2DB);
-	glBindRenderbuffer(GL_RENDERBUFFER, p2DB);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, 2048, 2048);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, p2DB);
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, p2Tex, 0);
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)// Always check that our framebuffer is ok
-		return false;
-
-	//==================================
-	//              Main Loop
-	//==================================
-
-	//Set a background color  
-	glClearColor(0.0f, 0.0f, 1.0f, 0.0f);
-
-	//TODO: turn on depth buffer
-	glEnable(GL_DEPTH_TEST);
-	glm::mat4 model;
-	
-	camera = new Camera(window, window_width, window_height);
-
-	//Main Loop  
-	clock_t start = std::clock();
-	double prev_time;
-	double frame_time = start;
-
-	do
-	{
-		glm::mat4 zero; //Thank god it defaults to the zero matrix
-		prev_time = frame_time;
-		frame_time = (double)(clock() - start) / double(CLOCKS_PER_SEC);
-		float period = 10; //seconds
-		glm::vec4 light_position;
-		GLint uniLightPos;
-		glm::vec4 light_colour(15, 15, 15, 1); //Increasing may change intensity
-		GLint uniLightCol;
-		glm::vec4 light2;
-		glm::vec4 lightCol2(10 + 10 * sin(frame_time), 20 - 20 * cos(frame_time), 20, 1);
-
-		//Rigid Body Physics
-		if (frame_time - prev_time > 0)
-		{
-			dynamicsWorld->stepSimulation(frame_time - prev_time, 1000);
-		}
-		camera->move(frame_time - prev_time);
-		glUseProgram(shaderProgram);
-		glUniform1i(modeU, shaderMode);
-
-		GLint uniModel = glGetUniformLocation(shaderProgram, "model");
-		GLint uniView = glGetUniformLocation(shaderProgram, "view");
-		GLint uniProj = glGetUniformLocation(shaderProgram, "proj");
-
-		//Create and load projection matrix
-		glm::mat4 proj = glm::perspective(
-			45.0f,										//VERTICAL FOV
-			float(window_width) / float(window_height), //aspect ratio
-			0.1f,                                       //near plane distance (min z)
-			1000.0f                                     //Far plane distance  (max z)
-		);
-
-		glm::mat4 projSq = glm::perspective(45.0f, 1.0f, 0.1f, 1000.0f);
-
-		glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(projSq));
-
-		//Camera control
-		glm::vec3 target = camera->getPosition() + camera->getRotVec();
-		glm::vec3 up = camera->getUpVec();
-		glm::mat4 view = glm::lookAt(camera->getPosition(), target, up);
-
-		//Render from the view of portal 1
-		glBindFramebuffer(GL_FRAMEBUFFER, p1FB);
-		glViewport(0, 0, 2048, 2048);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //Clear buffers
-
-		glm::mat4 portCam1 =
-			glm::scale(glm::mat4(1.0), glm::vec3(-1, -1, 1))
-			* view
-			* glm::translate(zero, port1Pos)
-			* glm::rotate(glm::mat4(1.0f), port1RAn, port1RAx)
-			* glm::rotate(glm::mat4(1.0), 180.0f, glm::vec3(0.0, 0.0, 1.0))
-			* glm::inverse(glm::translate(zero, port2Pos)*glm::rotate(glm::mat4(1.0f), port2RAn, port2RAx))
-			;
-		
-		glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(portCam1));
-
-		drawPhysObject(rigidBodyArr[1], texArray[1], meshArray[0], buffArray[0], numVArray[0], uniModel);
-		drawPhysObject(rigidBodyArr[2], texArray[0], meshArray[1], buffArray[1], numVArray[1], uniModel);
-		drawPhysObject(rigidBodyArr[3], texArray[0], meshArray[0], buffArray[0], numVArray[0], uniModel);
-		drawObject(glm::vec3(0, 0, 0), 0, glm::vec3(0, 0, 1), glm::vec3(1, 1, 1), texArray[1], meshArray[2], buffArray[2], numVArray[2], uniModel);
-		drawObject(glm::vec3(40, 0, 0), 90, glm::vec3(0, 1, 0), glm::vec3(1, 1, 1), texArray[1], meshArray[2], buffArray[2], numVArray[2], uniModel);
-		drawPhysObject(rigidBodyArr[4], texArray[2], meshArray[3], buffArray[3], numVArray[3], uniModel);
-		
-		//Render from the view of portal 2
-		glBindFramebuffer(GL_FRAMEBUFFER, p2FB);
-		glViewport(0, 0, 2048, 2048);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //Clear buffers
-
-		glm::mat4 portCam2 = 
-			glm::scale(glm::mat4(1.0), glm::vec3(-1, -1, 1)) 
-			* view 
-			* glm::translate(zero, port2Pos)
-			* glm::rotate(glm::mat4(1.0f), port2RAn, port2RAx) 
-			* glm::rotate(glm::mat4(1.0), 180.0f, glm::vec3(0.0, 0.0, 1.0))
-			* glm::inverse(glm::translate(zero, port1Pos)*glm::rotate(glm::mat4(1.0f), port1RAn, port1RAx));
-
-		glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(portCam2));
-
-		drawPhysObject(rigidBodyArr[1], texArray[1], meshArray[0], buffArray[0], numVArray[0], uniModel);
-		drawPhysObject(rigidBodyArr[2], texArray[0], meshArray[1], buffArray[1], numVArray[1], uniModel);
-		drawPhysObject(rigidBodyArr[3], texArray[0], meshArray[0], buffArray[0], numVArray[0], uniModel);
-		drawObject(glm::vec3(0, 0, 0), 0, glm::vec3(0, 0, 1), glm::vec3(1, 1, 1), texArray[1], meshArray[2], buffArray[2], numVArray[2], uniModel);
-		drawObject(glm::vec3(40, 0, 0), 90, glm::vec3(0, 1, 0), glm::vec3(1, 1, 1), texArray[1], meshArray[2], buffArray[2], numVArray[2], uniModel);
-		drawPhysObject(rigidBodyArr[4], texArray[2], meshArray[3], buffArray[3], numVArray[3], uniModel);
-		
-		//Render from the camera
-		glBindFramebuffer(GL_FRAMEBUFFER, screenFB);
-		glViewport(0, 0, window_width, window_height); // Render on the whole framebuffer, complete from the lower left corner to the upper right
-		
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //Clear buffers
-		glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(proj));
-		//Camera control
-		glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
-		
-		//Draw scene
-		drawPhysObject(rigidBodyArr[1], texArray[1], meshArray[0], buffArray[0], numVArray[0], uniModel);
-		drawPhysObject(rigidBodyArr[2], texArray[0], meshArray[1], buffArray[1], numVArray[1], uniModel);
-		drawPhysObject(rigidBodyArr[3], texArray[0], meshArray[0], buffArray[0], numVArray[0], uniModel);
-		drawObject(glm::vec3(0, 0, 0), 0, glm::vec3(0, 0, 1), glm::vec3(1, 1, 1), texArray[1], meshArray[2], buffArray[2], numVArray[2], uniModel);
-		drawObject(glm::vec3(40, 0, 0), 90, glm::vec3(0, 1, 0), glm::vec3(1, 1, 1), texArray[1], meshArray[2], buffArray[2], numVArray[2], uniModel);
-		drawPhysObject(rigidBodyArr[4], texArray[2], meshArray[3], buffArray[3], numVArray[3], uniModel);
-		
-		
-		drawObject(port1Pos, port1RAn, port1RAx, glm::vec3(1, 1, 1), p1Tex, meshArray[4], buffArray[4], numVArray[4], uniModel);
-		drawObject(port2Pos, port2RAn, port2RAx, glm::vec3(1, 1, 1), p2Tex, meshArray[4], buffArray[4], numVArray[4], uniModel);
-
-
-		//Grids on the XZ axis, supposed to be used for gathering bearings.
-		glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(zero));
-		drawGround(000.0f); // Draw lower ground grid
-		drawGround(100.0f); // Draw upper ground grid
-
-		//Lights
-		light_position = view * glm::rotate(zero, 180 * float(frame_time) / period, glm::vec3(0.0f, 0.0f, 1.0f)) * glm::vec4(1, 20, 2, 1.0);
-		uniLightPos = glGetUniformLocation(shaderProgram, "light_position");
-		glUniform4fv(uniLightPos, 1, glm::value_ptr(light_position));
-		uniLightCol = glGetUniformLocation(shaderProgram, "light_colour");
-		glUniform4fv(uniLightCol, 1, glm::value_ptr(light_colour));
-		light2 = view * glm::vec4(0, 0, 3, 1.0);
-		glUniform4fv(uniLightPos + 1, 1, glm::value_ptr(light2));
-		glUniform4fv(uniLightCol + 1, 1, glm::value_ptr(lightCol2));
-
-		//===========================
-		//Render to texture to screen
-		//===========================
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);//Select the regular FB?
-		glViewport(0, 0, window_width, window_height);// Render on the whole framebuffer, complete from the lower left corner to the upper right
-		glUseProgram(fake_prog);// Use the passthrough shader
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);// Clear the screen
-		glActiveTexture(GL_TEXTURE0);// Bind our texture in Texture Unit 0
-		glBindTexture(GL_TEXTURE_2D, screenTex);
-		glUniform1i(texID, 0);// Set our "renderedTexture" sampler to use Texture Unit 0
-		
-		// 1rst attribute buffer : vertices
-		//Select the quad mesh
-		glBindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer);		
-		glBindVertexArray(quad_mesh);
-		glEnableVertexAttribArray(0);//Enable the vertex array
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-		
-		// Draw the triangles
-		glDrawArrays(GL_TRIANGLES, 0, 6); // 2*3 indices starting at 0 -> 2 triangles
-		glDisableVertexAttribArray(0);//Disable the vertex array
-
-
-
-		//Swap buffers  (Actually render to screen)
-		glfwSwapBuffers(window);
-
-		//Get and organize events, like keyboard and mouse input, window resizing, etc...  
-		glfwPollEvents();
-
-	} //Check if the ESC key had been pressed or if the window had been closed  
-	while (!glfwWindowShouldClose(window));
-
-	//Close OpenGL window and terminate GLFW  
-	glfwDestroyWindow(window);
-	//Finalize and clean up GLFW  
-	glfwTerminate();
-
-	for (int i = 0; i < numMeshes; i++)
-	{
-		dynamicsWorld->removeRigidBody(rigidBodyArr[i]);
-		delete rigidBodyArr[i]->getMotionState();
-		delete rigidBodyArr[i];
-	}
-	//delete groundShape;
-	delete camera;
-	delete dynamicsWorld;
-	/*delete solver;
-	delete dispatcher;
-	delete collisionConfiguration;
-	delete broadphase;
-	*/
-	exit(EXIT_SUCCESS);
+//NOTE, up is +ve Z axis.
+
+//Include GLEW  
+//#define GLEW_STATIC
+
+#include <GL/glew.h>  
+
+#include<iostream> //cout
+#include <fstream> //fstream
+#include <vector> 
+#include <algorithm>
+#include <ctime> 
+#include <chrono>
+#include <thread>
+
+//Include GLFW  
+#include <GLFW/glfw3.h>  
+
+//Include the standard C++ headers  
+#include <stdio.h>  
+#include <stdlib.h> 
+
+//Include matrix libraries
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/matrix_inverse.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+//Our includes
+#include "camera.h"
+#include "mesh.h"
+#include "assetloader.h"
+#include "renderqueue.h"
+#include "scene.h"
+#include "portal.h"
+#include "postprocess.h"
+#include "physicsthread.h"
+#include "shapecache.h"
+#include "physicsworld.h"
+#include "physicsbodies.h"
+#include "uniforms.h"
+#include "lights.h"
+#include "programcache.h"
+#include "shadervariants.h"
+#include "profiler.h"
+#include "camerapath.h"
+#ifdef HEADLESS
+#include "headless.h"
+#endif
+#include <btBulletDynamicsCommon.h>
+
+//Constants and globals
+const int window_width = 1024;
+const int window_height = 768;
+const double physics_step = 1.0 / 120; //Seconds simulated per physics step
+const int max_physics_steps = 8;       //Most steps one frame can catch up on, time beyond that is dropped
+const int physics_threads = 1;         //Threads the Bullet world is solved on, 1 for the plain single threaded world.
+                                       //0 is one per core. Can be overridden by the second command line argument.
+const int portal_min_size = 128;  //Portal render target sizes, powers of two
+const int portal_max_size = 2048;
+Camera *camera; //For key modification
+PhysicsWorld* physicsWorld; //The Bullet world, owns every body in it
+ShapeCache* shapeCache; //Every collision shape, shared between the bodies that use it
+PhysicsThread* physics; //Steps physicsWorld, takes raytraces and grabs on keypress as commands
+Profiler* profiler; //Times each pass on the CPU and GPU, E prints it and C captures a trace
+int shaderMode = 0;              //Which variant V has picked, see SHADING_MODE in shader.frag
+CullStats passStats[3]; //Portal 1, portal 2 and main view, from the last frame
+int portalSizes[2];     //Render target size each portal got last frame, 0 if it was skipped
+bool stencilPortals = false;    //P switches between portals drawn through textures and through the stencil buffer
+int stencilPortalViews;         //Views the stencil portals drew last frame
+double physicsStepTime;         //Seconds the latest physics step took
+int lightCount;                 //Point lights in the world
+int lightEntries;               //Cluster-light pairs binned for the main view last frame
+UploadStats uploadStats;        //Asset streaming as of the latest frame
+int postMode = 0;               //Which post process chain O has picked, see applyPostMode()
+bool instancingToggled = false; //Set by the I key, main() flips the render queue and reports timings
+bool pathRecordToggled = false; //Set by the K key, main() starts or finishes recording camera.path
+
+										//Define an error callback  
+static void error_callback(int error, const char* description)
+{
+	fputs(description, stderr);
+#ifdef _WIN32
+	getchar(); //Keep the console open long enough to read it
+#endif
+}
+
+//Grab whatever is under the crosshair, or drop it if it's already held. Runs on the physics thread, which prints what was hit.
+void printUnderCamera()
+{
+	PhysicsCommand command;
+	command.type = PhysicsCommand::PICK;
+	command.origin = camera->getPosition();
+	command.direction = camera->getRotVec();
+	physics->post(command);
+}
+
+//Scale what's held and how far away it is, a factor of 0 puts both back to normal
+void postGrabScale(float factor)
+{
+	PhysicsCommand command;
+	command.type = factor > 0 ? PhysicsCommand::GRAB_SCALE : PhysicsCommand::GRAB_RESET;
+	command.factor = factor;
+	physics->post(command);
+}
+
+//Define the key input callback  
+static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, GL_TRUE);
+	else
+	{
+		if (key == GLFW_KEY_E && action == GLFW_PRESS)
+		{
+			//Debug data dump
+			glm::vec3 temp = camera->getPosition() + camera->getRotVec();
+			std::cout << camera->getXPos() << "\t" << camera->getYPos() << "\t" << camera->getZPos() << "\t" << std::endl;
+			std::cout << temp.x << "\t" << temp.y << "\t" << temp.z << std::endl;
+			const char* passNames[3] = { "Portal 1", "Portal 2", "Main" };
+			for (int i = 0; i < 3; i++)
+			{
+				std::cout << passNames[i] << ":\t" << passStats[i].submitted << " drawn, " << passStats[i].culled << " culled";
+				if (i < 2) std::cout << ", " << portalSizes[i] << "x" << portalSizes[i] << " target";
+				std::cout << std::endl;
+			}
+			if (stencilPortals) std::cout << "Stencil portals:\t" << stencilPortalViews << " views" << std::endl;
+			std::cout << "Physics:\t" << 1000 * physicsStepTime << " ms/step" << std::endl;
+			std::cout << "Lights:\t" << lightCount << " lights, " << lightEntries << " cluster entries in the main view" << std::endl;
+			std::cout << "Uploads:\t" << uploadStats.uploads << " done, " << uploadStats.bytes / 1024 << " KB, " << uploadStats.queued << " queued, "
+				<< uploadStats.waits << " waits, ring " << uploadStats.ringUsed / 1024 << "/" << uploadStats.ringSize / 1024 << " KB" << std::endl;
+			profiler->print(std::cout);
+		}
+		if (key == GLFW_KEY_Q && action == GLFW_PRESS)
+		{
+			camera->altLock = !camera->altLock;
+		}
+		if (key == GLFW_KEY_R && action == GLFW_PRESS)
+		{
+			//Do a raytrace through the camera.
+			printUnderCamera();
+		}
+		if (key == GLFW_KEY_F && action == GLFW_PRESS)
+		{
+			postGrabScale(5.0f / 4);
+		}
+		if (key == GLFW_KEY_G && action == GLFW_PRESS)
+		{
+			postGrabScale(4.0f / 5);
+		}
+		if (key == GLFW_KEY_T && action == GLFW_PRESS)
+		{
+			postGrabScale(0);
+		}
+		if (key == GLFW_KEY_K && action == GLFW_PRESS)
+		{
+			pathRecordToggled = true;
+		}
+		if (key == GLFW_KEY_C && action == GLFW_PRESS)
+		{
+			//Start a trace, or write out the one running for chrome://tracing
+			if (!profiler->isCapturing())
+			{
+				profiler->startCapture();
+				std::cout << "Trace: capturing, C again to write trace.json" << std::endl;
+			}
+			else if (!profiler->stopCapture("trace.json")) std::cout << "WARNING: couldn't write trace.json" << std::endl;
+		}
+		if (key == GLFW_KEY_V && action == GLFW_PRESS)
+		{
+			shaderMode = (shaderMode+1)%SHADING_MODE_COUNT;
+		}
+		if (key == GLFW_KEY_P && action == GLFW_PRESS)
+		{
+			stencilPortals = !stencilPortals;
+		}
+		if (key == GLFW_KEY_O && action == GLFW_PRESS)
+		{
+			postMode = (postMode + 1) % 3;
+		}
+		if (key == GLFW_KEY_I && action == GLFW_PRESS)
+		{
+			instancingToggled = true;
+		}
+
+		camera->handleKeypress(key, action);
+	}
+
+}
+
+void handleMouseMove(GLFWwindow *window, double mouseX, double mouseY)
+{
+	camera->handleMouseMove(window, mouseX, mouseY);
+}
+
+void drawGround(float groundLevel)
+{
+	GLfloat extent = 600.0f; // How far on the Z-Axis and X-Axis the ground extends
+	GLfloat stepSize = 10.0f;  // The size of the separation between points
+	glColor3b(255, 255, 255);	//Set colour, probably broken.
+
+								// Draw our ground grid
+	glBegin(GL_LINES);
+	for (GLint loop = -extent; loop < extent; loop += stepSize)
+	{
+		// Draw lines along Y-Axis
+		glVertex3f(loop, extent, groundLevel);
+		glVertex3f(loop, -extent, groundLevel);
+
+		// Draw lines across X-Axis
+		glVertex3f(-extent, loop, groundLevel);
+		glVertex3f(extent, loop, groundLevel);
+	}
+	glEnd();
+}
+
+GLFWwindow* makeWindow()
+{
+	//Declare a window object  
+	GLFWwindow* window;
+
+	//Create a window and create its OpenGL context
+	window = glfwCreateWindow(window_width, window_height, "Perspective", NULL, NULL);
+
+	//If the window couldn't be created  
+	if (!window)
+	{
+		fprintf(stderr, "Failed to open GLFW window.\n");
+		glfwTerminate();
+		exit(EXIT_FAILURE);
+	}
+
+	//This function makes the context of the specified window current on the calling thread.   
+	glfwMakeContextCurrent(window);
+	return window;
+}
+
+GLFWwindow* init()
+//Initialises GLFW, GLEW and returns the window object
+{
+	//Set the error callback  
+	glfwSetErrorCallback(error_callback);
+
+	//Initialize GLFW  
+	if (!glfwInit())
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	//Set the GLFW window creation hints - these are optional  
+	//glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); //Request a specific OpenGL version  
+	//glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2); //Request a specific OpenGL version  
+	//glfwWindowHint(GLFW_SAMPLES, 16); //Request 4x antialiasing  
+	//glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);  
+	glfwWindowHint(GLFW_DEPTH_BITS, 24);  //The scene is drawn straight into the backbuffer when there's no post processing,
+	glfwWindowHint(GLFW_STENCIL_BITS, 8); //so it needs the stencil the stencil portals use
+
+	GLFWwindow* window = makeWindow();
+
+	//Sets the key callback  
+	glfwSetKeyCallback(window, key_callback);
+	glfwSetCursorPosCallback(window, handleMouseMove);
+
+	//Initialize GLEW  
+	glewExperimental = GL_TRUE;
+	GLenum err = glewInit();
+
+	//If GLEW hasn't initialized  
+	if (err != GLEW_OK)
+	{
+		fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
+		exit(-1);
+	}
+	return window;
+}
+
+#ifdef HEADLESS
+//Initialises an offscreen context and GLEW, with headless's framebuffer in place of a window
+bool initHeadless(HeadlessContext& headless)
+{
+	if (!headless.create()) return false;
+
+	glewExperimental = GL_TRUE;
+	GLenum err = glewInit();
+	//GLEW built for GLX looks for an X display after loading everything, there isn't one and doesn't need to be
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	if (err == GLEW_ERROR_NO_GLX_DISPLAY) err = GLEW_OK;
+#endif
+	if (err != GLEW_OK)
+	{
+		fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
+		return false;
+	}
+	if (!headless.createFramebuffer(window_width, window_height))
+	{
+		fprintf(stderr, "Failed to create the offscreen framebuffer.\n");
+		return false;
+	}
+	std::cout << "Headless: " << glGetString(GL_RENDERER) << ", GL " << glGetString(GL_VERSION) << std::endl;
+	return true;
+}
+#endif
+
+//The scene's program, once it has linked or come out of the cache
+void setupSceneProgram(GLuint program)
+{
+	bindUniformBlocks(program);
+	bindLightTextures(program);
+}
+
+//Create rigid bodies for every entity that asks for one
+void makeScenePhysics(Scene& scene)
+{
+	physicsWorld->reserve(scene.entities.size());
+	for (size_t i = 0; i < scene.entities.size(); i++)
+	{
+		Entity& entity = scene.entities[i];
+		if (entity.hasBody)
+		{
+			std::string meshFile = entity.mesh >= 0 ? scene.meshes[entity.mesh]->name : "";
+			entity.body = physicsWorld->get(spawnBody(*physicsWorld, *shapeCache, entity.shape, entity.position, entity.rotation, entity.size, entity.mass, (int)i, meshFile));
+		}
+	}
+}
+
+//0 is no effects, 1 a fused vignette and greyscale, 2 a sharpen with the vignette fused into it
+void applyPostMode(PostChain& chain, int mode)
+{
+	chain.clearEffects();
+	if (mode == 1)
+	{
+		chain.addEffect(POST_VIGNETTE);
+		chain.addEffect(POST_GREYSCALE);
+	}
+	else if (mode == 2)
+	{
+		chain.addEffect(POST_SHARPEN);
+		chain.addEffect(POST_VIGNETTE);
+	}
+	std::cout << "Post process: " << chain.effectCount() << " effects in " << chain.stageCount() << " passes" << std::endl;
+}
+
+//Pull body transforms out of the latest physics snapshot, once per frame before any pass is drawn.
+//Drawing runs a step behind the simulation: each body is blended from its transform before the snapshot's step
+//to the one after by how far the clock is past it, so motion stays smooth whatever the frame rate.
+void updateSceneTransforms(Scene& scene, const PhysicsSnapshot& snapshot, double time, double step)
+{
+	float alpha = float((time - snapshot.time) / step);
+	alpha = alpha < 0 ? 0 : (alpha > 1 ? 1 : alpha);
+	for (size_t i = 0; i < scene.entities.size() && i < snapshot.bodies.size(); i++)
+	{
+		Entity& entity = scene.entities[i];
+		if (entity.body != NULL)
+		{
+			const BodyState& state = snapshot.bodies[i];
+			glm::vec3 position = glm::mix(state.previousPosition, state.position, alpha);
+			//What's held is drawn where the camera is now, not where it was when the physics last caught up
+			if ((int)i == snapshot.selected) position = camera->getPosition() + camera->getRotVec()*snapshot.grabDist;
+			entity.model = glm::translate(glm::mat4(1.0f), position)
+				* glm::mat4_cast(glm::slerp(state.previousRotation, state.rotation, alpha))
+				* glm::scale(glm::mat4(1.0f), state.scale);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef HEADLESS
+	//No window or input, the camera flies a path for a set number of frames and the results are written out
+	HeadlessContext headless;
+	if (!initHeadless(headless)) exit(EXIT_FAILURE);
+	GLFWwindow* window = NULL;
+	int benchmarkFrames = argc > 3 ? atoi(argv[3]) : 600;
+	CameraPath benchmarkPath;
+	if (!benchmarkPath.load(argc > 4 ? argv[4] : "default.path")) exit(EXIT_FAILURE);
+	std::vector<double> benchmarkTimes;
+	benchmarkTimes.reserve(benchmarkFrames);
+#else
+	GLFWwindow* window = init();
+#endif
+	
+	//==================================
+	//     Compile and Link Shaders
+	//==================================
+	//Linked binaries are cached on disk, and nothing waits on the driver until programs.finish()
+	ProgramCache programs;
+	//Every program has the same attribute locations, so a mesh's VAO works with any variant
+	for (int s = 0; s < ATTRIB_SEMANTIC_COUNT; s++) programs.bindAttribute(VERTEX_SEMANTIC_NAMES[s], s);
+	programs.bindAttribute("instanceModel", ATTRIB_SEMANTIC_COUNT); //And the three after it, one per column
+	//The scene shader specialised for each shading mode and kind of surface
+	ShaderVariants sceneShaders(programs, "shader.vert", "shader.frag", setupSceneProgram);
+	//The variant that reads every attribute, for setting up VAOs against
+	GLuint shaderProgram = sceneShaders.get(0, VARIANT_TEXTURED | VARIANT_VERTEX_COLOUR);
+	//Camera and projection, shared by every program through uniform blocks
+	UniformBuffers uniforms;
+	//Point lights, binned again for every view drawn
+	LightManager lights;
+
+	//==================================
+	//   Start loading meshes/textures
+	//==================================
+	//Import and decode happen on worker threads, the main loop starts straight away and
+	//each asset appears once its GL upload has run in loader.processUploads()
+	AssetLoader loader;
+	//Link Vertex Data to Shaders as each mesh arrives
+	loader.setMeshReadyCallback([shaderProgram](Mesh& mesh) {
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+		linkVertexLayout(mesh.layout, shaderProgram);
+	});
+
+	//Meshes, textures, materials and entities all come from the scene file
+	Scene scene;
+	//Another scene can be given on the command line, e.g. stress.scene
+	scene.load(argc > 1 ? argv[1] : "default.scene", loader, sceneShaders);
+	int plateMesh = scene.findMesh("plate");
+	//Two moving lights, then whatever the scene has
+	PointLight moving = { glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), 0 };
+	int orbitLight = lights.add(moving);
+	int pulseLight = lights.add(moving);
+	for (size_t i = 0; i < scene.lights.size(); i++) lights.add(scene.lights[i]);
+	lightCount = (int)lights.size();
+
+	//==================================
+	//          Physics Setup
+	//==================================
+
+	//Every pass is timed from here on, the physics thread adds its steps
+	profiler = new Profiler();
+	int frameScope = profiler->addScope("Frame");
+	int portal1Scope = profiler->addScope("Portal 1");
+	int portal2Scope = profiler->addScope("Portal 2");
+	int mainScope = profiler->addScope("Main scene");
+	int groundScope = profiler->addScope("Ground grid");
+	int blitScope = profiler->addScope("Blit");
+#ifdef HEADLESS
+	int swapScope = profiler->addScope("Finish");
+#else
+	int swapScope = profiler->addScope("Swap");
+#endif
+
+	//e.g. "stress.scene 4" solves the stress test on four threads
+	physicsWorld = new PhysicsWorld(argc > 2 ? atoi(argv[2]) : physics_threads);
+	shapeCache = new ShapeCache(importMeshPositions, MESH_IMPORT_FLAGS);
+	makeScenePhysics(scene);
+	std::vector<btRigidBody*> bodies(scene.entities.size());
+	for (size_t i = 0; i < scene.entities.size(); i++) bodies[i] = scene.entities[i].body;
+	//From here on only the physics thread touches the world and its bodies
+	physics = new PhysicsThread(physicsWorld->getWorld(), shapeCache, bodies, physics_step, max_physics_steps);
+	physics->setProfiler(profiler);
+	//--end of physics setup--
+
+	RenderQueue renderQueue;
+
+	//The driver has been compiling while the scene and physics were set up
+	programs.finish();
+	std::cout << "Programs: " << programs.getLoadedCount() << " from the cache, " << programs.getCompiledCount() << " compiled" << std::endl;
+
+	//Full screen effects, the scene goes straight to the backbuffer while there are none
+	PostChain postChain(window_width, window_height, "pass.vert", "pass.frag", programs);
+	int appliedPostMode = -1;
+	
+	//===================
+	//Portal Modification
+	//===================
+	//Define positions for both portals.
+	glm::vec3 port1Pos = glm::vec3(20, 10, 1);
+	glm::vec3 port1RAx = glm::vec3(0, 0, 1);
+	float     port1RAn = 00.0;
+	glm::vec3 port2Pos = glm::vec3(15, -10, 1);
+	glm::vec3 port2RAx = glm::vec3(0, 0, 1);
+	float     port2RAn = -90.0;
+	//Set up blank textures for the portals
+	GLuint whiteTex;
+	unsigned char white[3];
+	white[0] = 255;
+	white[1] = 255;
+	white[2] = 255;
+	glGenTextures(1, &whiteTex);
+	glBindTexture(GL_TEXTURE_2D, whiteTex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	//Portal views are rendered into pooled targets sized to how big each portal is on screen
+	PortalTargetPool portalTargets(portal_min_size, portal_max_size);
+	//Or drawn straight to the screen, looking through up to two portals deep
+	StencilPortalRenderer portalRenderer(2, 8);
+
+	//==================================
+	//              Main Loop
+	//==================================
+
+	//Set a background color  
+	glClearColor(0.0f, 0.0f, 1.0f, 0.0f);
+
+	//TODO: turn on depth buffer
+	glEnable(GL_DEPTH_TEST);
+	glm::mat4 model;
+	
+	camera = new Camera(window, window_width, window_height);
+	//K records the camera's flight to camera.path, for the headless benchmark to play back
+	CameraPath recordedPath;
+	bool recordingPath = false;
+	double pathStart = 0;
+
+#ifdef HEADLESS
+	postChain.setOutputFramebuffer(headless.getFramebuffer());
+	//Frames are only comparable once everything is on the GPU, so loading finishes before the clock starts
+	while (!loader.isIdle())
+	{
+		loader.processUploads();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	glFinish();
+#endif
+
+	//Main Loop  
+	//Frames are timed with a monotonic wall clock, std::clock() counts CPU time and misses time spent waiting on the GPU
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double prev_time;
+	double frame_time = 0;
+	//Rigid Body Physics, in fixed steps on its own thread so the results don't depend on the frame rate
+	//and the simulation overlaps drawing
+	physics->start(start);
+	//Wall clock frame times for the current instancing mode, printed when I switches mode
+	double frameStart = 0;
+	double modeTime = 0;
+	int modeFrames = 0;
+
+	do
+	{
+		//Gather last frame's timings, then time this one
+		profiler->beginFrame();
+		ProfileScope timeFrame(profiler, frameScope);
+		glm::mat4 zero; //Thank god it defaults to the zero matrix
+		prev_time = frame_time;
+		frame_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		//Create GL objects for any assets the workers have finished with, within this frame's upload budget
+		loader.processUploads();
+		uploadStats = loader.getUploadStats();
+
+		//Lights, in world space so every view can share them
+		float period = 10; //seconds
+		PointLight& orbit = lights.get(orbitLight);
+		orbit.position = glm::vec3(glm::rotate(zero, 180 * float(frame_time) / period, glm::vec3(0.0f, 0.0f, 1.0f)) * glm::vec4(1, 20, 2, 1.0));
+		orbit.colour = glm::vec3(15, 15, 15); //Increasing may change intensity
+		orbit.radius = lightRadius(orbit.colour);
+		PointLight& pulse = lights.get(pulseLight);
+		pulse.position = glm::vec3(0, 0, 3);
+		pulse.colour = glm::vec3(10 + 10 * sin(frame_time), 20 - 20 * cos(frame_time), 20);
+		pulse.radius = lightRadius(pulse.colour);
+		uniforms.beginFrame();
+		sceneShaders.setMode(shaderMode);
+
+		camera->move(frame_time - prev_time);
+#ifdef HEADLESS
+		//The whole path over benchmarkFrames frames, however long it took to record
+		glm::vec3 pathPosition, pathRotation;
+		benchmarkPath.sample(benchmarkPath.getDuration() * benchmarkTimes.size() / std::max(benchmarkFrames - 1, 1), pathPosition, pathRotation);
+		camera->setPosition(pathPosition);
+		camera->setRotation(pathRotation);
+#endif
+		if (pathRecordToggled)
+		{
+			pathRecordToggled = false;
+			if (!recordingPath)
+			{
+				recordedPath.clear();
+				pathStart = frame_time;
+				std::cout << "Path: recording, K again to write camera.path" << std::endl;
+			}
+			else if (recordedPath.save("camera.path")) std::cout << "Path: " << recordedPath.size() << " keys written to camera.path" << std::endl;
+			else std::cout << "WARNING: couldn't write camera.path" << std::endl;
+			recordingPath = !recordingPath;
+		}
+		if (recordingPath) recordedPath.add(frame_time - pathStart, camera->getPosition(), camera->getRotation());
+		PhysicsCommand aim;
+		aim.type = PhysicsCommand::AIM;
+		aim.origin = camera->getPosition();
+		aim.direction = camera->getRotVec();
+		physics->post(aim);
+		const PhysicsSnapshot& snapshot = physics->latest();
+		updateSceneTransforms(scene, snapshot, frame_time, physics_step);
+		physicsStepTime = snapshot.stepTime;
+		scene.updateBounds();
+		bool plateReady = plateMesh >= 0 && scene.meshes[plateMesh]->ready;
+		GLuint plateProgram = sceneShaders.get(VARIANT_TEXTURED | (plateReady ? meshVariantFlags(scene.meshes[plateMesh]->mesh) : 0));
+
+		//Create and load projection matrix
+		glm::mat4 proj = glm::perspective(
+			45.0f,										//VERTICAL FOV
+			float(window_width) / float(window_height), //aspect ratio
+			0.1f,                                       //near plane distance (min z)
+			1000.0f                                     //Far plane distance  (max z)
+		);
+
+		glm::mat4 projSq = glm::perspective(45.0f, 1.0f, 0.1f, 1000.0f);
+
+		//Camera control
+		glm::vec3 target = camera->getPosition() + camera->getRotVec();
+		glm::vec3 up = camera->getUpVec();
+		glm::mat4 view = glm::lookAt(camera->getPosition(), target, up);
+
+		//Only the part of each portal texture that shows on screen this frame gets redrawn
+		glm::mat4 plate1Model = objectMatrix(port1Pos, port1RAn, port1RAx, glm::vec3(1, 1, 1));
+		glm::mat4 plate2Model = objectMatrix(port2Pos, port2RAn, port2RAx, glm::vec3(1, 1, 1));
+		//and at a resolution to match how many pixels it covers
+		PortalFootprint port1Footprint, port2Footprint;
+		bool port1Visible = !stencilPortals && plateMesh >= 0 && portalFootprint(proj * view, plate1Model, window_width, window_height, port1Footprint);
+		bool port2Visible = !stencilPortals && plateMesh >= 0 && portalFootprint(proj * view, plate2Model, window_width, window_height, port2Footprint);
+		portalTargets.beginFrame();
+		int port1Target = port1Visible ? portalTargets.acquire(portalTargets.chooseSize(port1Footprint)) : -1;
+		int port2Target = port2Visible ? portalTargets.acquire(portalTargets.chooseSize(port2Footprint)) : -1;
+		port1Visible = port1Target >= 0;
+		port2Visible = port2Target >= 0;
+		int port1Size = port1Visible ? portalTargets.get(port1Target).size : 0;
+		int port2Size = port2Visible ? portalTargets.get(port2Target).size : 0;
+		GLuint p1Tex = port1Visible ? portalTargets.get(port1Target).texture : whiteTex;
+		GLuint p2Tex = port2Visible ? portalTargets.get(port2Target).texture : whiteTex;
+		PortalRect port1Rect = port1Visible ? portalRect(port1Footprint, port1Size) : PortalRect();
+		PortalRect port2Rect = port2Visible ? portalRect(port2Footprint, port2Size) : PortalRect();
+		portalSizes[0] = port1Size;
+		portalSizes[1] = port2Size;
+		CullStats skipped = { 0, 0 };
+		passStats[0] = skipped;
+		passStats[1] = skipped;
+		glEnable(GL_SCISSOR_TEST);
+
+		//Render from the view of portal 1
+		if (port1Visible)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, portalTargets.get(port1Target).framebuffer);
+			glViewport(0, 0, port1Size, port1Size);
+			glScissor(port1Rect.x, port1Rect.y, port1Rect.width, port1Rect.height);
+		}
+
+		glm::mat4 portCam1 =
+			glm::scale(glm::mat4(1.0), glm::vec3(-1, -1, 1))
+			* view
+			* glm::translate(zero, port1Pos)
+			* glm::rotate(glm::mat4(1.0f), port1RAn, port1RAx)
+			* glm::rotate(glm::mat4(1.0), 180.0f, glm::vec3(0.0, 0.0, 1.0))
+			* glm::inverse(glm::translate(zero, port2Pos)*glm::rotate(glm::mat4(1.0f), port2RAn, port2RAx))
+			;
+		
+		if (port1Visible)
+		{
+			ProfileScope timePass(profiler, portal1Scope, true);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //Clear buffers
+			uniforms.setPass(portCam1, projSq, lights.cluster(portCam1, projSq, port1Size, port1Size));
+
+			renderQueue.clear();
+			passStats[0] = scene.buildQueue(renderQueue, makeFrustum(portalRectMatrix(port1Rect, port1Size) * projSq * portCam1));
+			renderQueue.sort();
+			renderQueue.submit();
+		}
+		
+		//Render from the view of portal 2
+		if (port2Visible)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, portalTargets.get(port2Target).framebuffer);
+			glViewport(0, 0, port2Size, port2Size);
+			glScissor(port2Rect.x, port2Rect.y, port2Rect.width, port2Rect.height);
+		}
+
+		glm::mat4 portCam2 = 
+			glm::scale(glm::mat4(1.0), glm::vec3(-1, -1, 1)) 
+			* view 
+			* glm::translate(zero, port2Pos)
+			* glm::rotate(glm::mat4(1.0f), port2RAn, port2RAx) 
+			* glm::rotate(glm::mat4(1.0), 180.0f, glm::vec3(0.0, 0.0, 1.0))
+			* glm::inverse(glm::translate(zero, port1Pos)*glm::rotate(glm::mat4(1.0f), port1RAn, port1RAx));
+
+		if (port2Visible)
+		{
+			ProfileScope timePass(profiler, portal2Scope, true);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //Clear buffers
+			uniforms.setPass(portCam2, projSq, lights.cluster(portCam2, projSq, port2Size, port2Size));
+
+			renderQueue.clear();
+			passStats[1] = scene.buildQueue(renderQueue, makeFrustum(portalRectMatrix(port2Rect, port2Size) * projSq * portCam2));
+			renderQueue.sort();
+			renderQueue.submit();
+		}
+		glDisable(GL_SCISSOR_TEST);
+		
+		//Render from the camera
+		{
+			ProfileScope timePass(profiler, mainScope, true);
+			if (postMode != appliedPostMode)
+			{
+				applyPostMode(postChain, postMode);
+				appliedPostMode = postMode;
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, postChain.getSceneFramebuffer());
+			glViewport(0, 0, window_width, window_height); // Render on the whole framebuffer, complete from the lower left corner to the upper right
+		
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT); //Clear buffers
+			//Camera control. The stencil portals bin lights for each of their levels themselves.
+			bool drawStencil = stencilPortals && plateReady;
+			uniforms.setPass(view, proj, drawStencil ? glm::vec4(0) : lights.cluster(view, proj, window_width, window_height));
+		
+			stencilPortalViews = 0;
+			if (drawStencil)
+			{
+				//Draw scene and the views through the portals in one go
+				std::vector<Portal> portals(2);
+				portals[0].model = plate1Model;
+				portals[0].destination = 1;
+				portals[1].model = plate2Model;
+				portals[1].destination = 0;
+				portalRenderer.render(scene, portals, scene.meshes[plateMesh]->mesh, plateProgram, whiteTex, uniforms, lights, view, proj, window_width, window_height);
+				passStats[2] = portalRenderer.getStats();
+				stencilPortalViews = portalRenderer.getViews();
+			}
+			else
+			{
+				//Draw scene, with the portals showing what their cameras saw
+				renderQueue.clear();
+				passStats[2] = scene.buildQueue(renderQueue, makeFrustum(proj * view));
+				if (plateReady)
+				{
+					renderQueue.push(plate1Model, scene.meshes[plateMesh]->mesh, p1Tex, plateProgram);
+					renderQueue.push(plate2Model, scene.meshes[plateMesh]->mesh, p2Tex, plateProgram);
+				}
+				renderQueue.sort();
+				renderQueue.submit();
+			}
+
+			lightEntries = lights.getLastEntries(); //The main view is always binned last
+		}
+
+		//Grids on the XZ axis, supposed to be used for gathering bearings.
+		{
+			ProfileScope timePass(profiler, groundScope, true);
+			glBindVertexArray(0); //So the generic attribute value is used rather than the last batch's instance buffer
+			GLuint groundProgram = sceneShaders.get(0); //Lines have no texture or colours
+			glUseProgram(groundProgram);
+			setInstanceModel(groundProgram, zero);
+			drawGround(000.0f); // Draw lower ground grid
+			drawGround(100.0f); // Draw upper ground grid
+		}
+
+		//Effects, if there are any, then to the screen
+		{
+			ProfileScope timePass(profiler, blitScope, true);
+			postChain.finish();
+		}
+
+		//Swap buffers  (Actually render to screen)
+		{
+			ProfileScope timeSwap(profiler, swapScope);
+#ifdef HEADLESS
+			//Nothing to present, so wait for the GPU instead and each frame's time includes its drawing
+			glFinish();
+#else
+			glfwSwapBuffers(window);
+#endif
+		}
+
+#ifndef HEADLESS
+		//Get and organize events, like keyboard and mouse input, window resizing, etc...  
+		glfwPollEvents();
+#endif
+
+		double frameEnd = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		modeTime += frameEnd - frameStart;
+#ifdef HEADLESS
+		benchmarkTimes.push_back(1000 * (frameEnd - frameStart));
+#endif
+		modeFrames++;
+		frameStart = frameEnd;
+		if (instancingToggled)
+		{
+			instancingToggled = false;
+			std::cout << (renderQueue.getInstancing() ? "Instanced" : "Not instanced") << ": " << 1000 * modeTime / modeFrames << " ms/frame over "
+				<< modeFrames << " frames, " << renderQueue.getDrawCalls() << " draw calls in the main pass" << std::endl;
+			renderQueue.setInstancing(!renderQueue.getInstancing());
+			modeTime = 0;
+			modeFrames = 0;
+		}
+
+	} //Check if the ESC key had been pressed or if the window had been closed  
+#ifdef HEADLESS
+	while ((int)benchmarkTimes.size() < benchmarkFrames);
+
+	writeBenchmarkReport("benchmark.txt", benchmarkTimes, *profiler);
+	if (!headless.saveImage("benchmark.bmp")) std::cout << "WARNING: couldn't write benchmark.bmp" << std::endl;
+#else
+	while (!glfwWindowShouldClose(window));
+#endif
+
+	//The physics thread times its steps with the profiler, whose queries need the context
+	physics->stop();
+	delete profiler;
+
+#ifndef HEADLESS
+	//Close OpenGL window and terminate GLFW  
+	glfwDestroyWindow(window);
+	//Finalize and clean up GLFW  
+	glfwTerminate();
+#endif
+
+	delete physics;
+	//Takes out every body, then the world and everything it was built from. Shapes go after the bodies using them.
+	delete physicsWorld;
+	delete shapeCache;
+	delete camera;
+	exit(EXIT_SUCCESS);
 }
\ No newline at end of file
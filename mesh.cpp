@@ -0,0 +1,542 @@
+//Mesh welding and reordering for indexed drawing.
+//Vertex cache ordering follows Tom Forsyth's "Linear-Speed Vertex Cache Optimisation",
+//overdraw ordering follows Sander, Nehab and Barczak's "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+
+#include "mesh.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+const char* const VERTEX_SEMANTIC_NAMES[ATTRIB_SEMANTIC_COUNT] = { "position", "normal", "colour", "texcoord" };
+
+GLushort floatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	unsigned int mantissa = bits & 0x007FFFFF;
+
+	if (((bits >> 23) & 0xFF) == 0xFF)
+	{
+		//Inf or NaN
+		return (GLushort)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	}
+	if (exponent >= 31)
+	{
+		//Too big, clamp to infinity
+		return (GLushort)(sign | 0x7C00);
+	}
+	if (exponent <= 0)
+	{
+		//Denormal or zero
+		if (exponent < -10) return (GLushort)sign;
+		mantissa |= 0x00800000;
+		unsigned int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1) half++; //Round
+		return (GLushort)(sign | half);
+	}
+	unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000) half++; //Round, carrying into the exponent is correct here
+	return (GLushort)half;
+}
+
+//Pack a unit vector into signed normalised 10:10:10:2, w is left at 0
+static GLuint packNormal(const GLfloat* n)
+{
+	GLuint packed = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		float c = n[k] < -1.0f ? -1.0f : (n[k] > 1.0f ? 1.0f : n[k]);
+		int q = (int)floorf(c * 511.0f + 0.5f);
+		packed |= ((GLuint)q & 0x3FF) << (10 * k);
+	}
+	return packed;
+}
+
+static GLubyte toUnorm8(float value)
+{
+	float c = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	return (GLubyte)floorf(c * 255.0f + 0.5f);
+}
+
+void packVertices(const MeshData& mesh, unsigned int formatFlags, PackedVertices& out)
+{
+	size_t count = mesh.vertexCount();
+
+	//Work out what the data needs
+	bool hasColour = false;
+	bool unitTexcoords = true;
+	for (size_t v = 0; v < count; v++)
+	{
+		const GLfloat* vert = &mesh.vertices[v * VERTEX_FLOATS];
+		if (vert[6] != 1.0f || vert[7] != 1.0f || vert[8] != 1.0f) hasColour = true;
+		if (vert[9] < 0.0f || vert[9] > 1.0f || vert[10] < 0.0f || vert[10] > 1.0f) unitTexcoords = false;
+	}
+	bool halfPositions = (formatFlags & FORMAT_HALF_POSITIONS) != 0;
+
+	//Half positions are stored relative to the middle of the bounds, scaled into [-1,1]
+	float boundsMin[3], boundsMax[3];
+	computeBounds(mesh, boundsMin, boundsMax);
+	out.positionScale = 1.0f;
+	for (int k = 0; k < 3; k++) out.positionOffset[k] = 0.0f;
+	if (halfPositions)
+	{
+		float extent = 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			out.positionOffset[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+			extent = fmaxf(extent, (boundsMax[k] - boundsMin[k]) * 0.5f);
+		}
+		out.positionScale = extent > 0.0f ? extent : 1.0f;
+	}
+
+	//Build the layout
+	VertexLayout& layout = out.layout;
+	layout.attributeCount = 0;
+	GLuint offset = 0;
+	VertexAttribute position = { ATTRIB_POSITION, 3, GLenum(halfPositions ? GL_HALF_FLOAT : GL_FLOAT), GL_FALSE, offset };
+	layout.attributes[layout.attributeCount++] = position;
+	offset += halfPositions ? 4 * sizeof(GLushort) : 3 * sizeof(GLfloat);
+	VertexAttribute normal = { ATTRIB_NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offset };
+	layout.attributes[layout.attributeCount++] = normal;
+	offset += sizeof(GLuint);
+	VertexAttribute texcoord = { ATTRIB_TEXCOORD, 2, GLenum(unitTexcoords ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT), GLboolean(unitTexcoords ? GL_TRUE : GL_FALSE), offset };
+	layout.attributes[layout.attributeCount++] = texcoord;
+	offset += 2 * sizeof(GLushort);
+	if (hasColour)
+	{
+		VertexAttribute colour = { ATTRIB_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE, offset };
+		layout.attributes[layout.attributeCount++] = colour;
+		offset += 4;
+	}
+	layout.stride = offset;
+
+	//Fill the buffer
+	out.data.assign(count * layout.stride, 0);
+	for (size_t v = 0; v < count; v++)
+	{
+		const GLfloat* vert = &mesh.vertices[v * VERTEX_FLOATS];
+		unsigned char* dst = &out.data[v * layout.stride];
+
+		if (halfPositions)
+		{
+			GLushort p[4] = { 0, 0, 0, 0 };
+			for (int k = 0; k < 3; k++) p[k] = floatToHalf((vert[k] - out.positionOffset[k]) / out.positionScale);
+			memcpy(dst, p, sizeof(p));
+			dst += sizeof(p);
+		}
+		else
+		{
+			memcpy(dst, vert, 3 * sizeof(GLfloat));
+			dst += 3 * sizeof(GLfloat);
+		}
+
+		GLuint n = packNormal(vert + 3);
+		memcpy(dst, &n, sizeof(n));
+		dst += sizeof(n);
+
+		GLushort uv[2];
+		for (int k = 0; k < 2; k++)
+		{
+			uv[k] = unitTexcoords ? (GLushort)floorf(vert[9 + k] * 65535.0f + 0.5f) : floatToHalf(vert[9 + k]);
+		}
+		memcpy(dst, uv, sizeof(uv));
+		dst += sizeof(uv);
+
+		if (hasColour)
+		{
+			GLubyte rgba[4] = { toUnorm8(vert[6]), toUnorm8(vert[7]), toUnorm8(vert[8]), 255 };
+			memcpy(dst, rgba, sizeof(rgba));
+		}
+	}
+}
+
+void linkVertexLayout(const VertexLayout& layout, GLuint shaderProgram)
+{
+	bool linked[ATTRIB_SEMANTIC_COUNT] = { false, false, false, false };
+	for (int i = 0; i < layout.attributeCount; i++)
+	{
+		const VertexAttribute& a = layout.attributes[i];
+		GLint location = glGetAttribLocation(shaderProgram, VERTEX_SEMANTIC_NAMES[a.semantic]);
+		linked[a.semantic] = true;
+		if (location < 0) continue; //Optimised out of the shader
+		glVertexAttribPointer(location, a.components, a.type, a.normalized, layout.stride, (void*)(size_t)a.offset);
+		glEnableVertexAttribArray(location);
+	}
+
+	for (int s = 0; s < ATTRIB_SEMANTIC_COUNT; s++)
+	{
+		GLint location = glGetAttribLocation(shaderProgram, VERTEX_SEMANTIC_NAMES[s]);
+		if (linked[s] || location < 0) continue;
+		glDisableVertexAttribArray(location);
+		//Disabled attributes read the current generic value, which isn't VAO state, so this is shared by every mesh
+		if (s == ATTRIB_COLOUR) glVertexAttrib4f(location, 1.0f, 1.0f, 1.0f, 1.0f);
+	}
+}
+
+void computeBounds(const MeshData& mesh, float boundsMin[3], float boundsMax[3])
+{
+	for (int k = 0; k < 3; k++)
+	{
+		boundsMin[k] = mesh.vertexCount() ? mesh.vertices[k] : 0.0f;
+		boundsMax[k] = boundsMin[k];
+	}
+	for (size_t v = 0; v < mesh.vertexCount(); v++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			GLfloat p = mesh.vertices[v * VERTEX_FLOATS + k];
+			if (p < boundsMin[k]) boundsMin[k] = p;
+			if (p > boundsMax[k]) boundsMax[k] = p;
+		}
+	}
+}
+
+void packIndices(const MeshData& mesh, std::vector<unsigned char>& out, GLenum& indexType)
+{
+	if (mesh.vertexCount() <= 0xFFFF)
+	{
+		//Small meshes get 16 bit indices to halve the index buffer
+		indexType = GL_UNSIGNED_SHORT;
+		out.resize(mesh.indices.size() * sizeof(GLushort));
+		GLushort* dst = (GLushort*)(out.empty() ? NULL : &out[0]);
+		for (size_t i = 0; i < mesh.indices.size(); i++) dst[i] = (GLushort)mesh.indices[i];
+	}
+	else
+	{
+		indexType = GL_UNSIGNED_INT;
+		out.resize(mesh.indices.size() * sizeof(GLuint));
+		if (!out.empty()) memcpy(&out[0], &mesh.indices[0], out.size());
+	}
+}
+
+//Hash the raw bits of a vertex so that identical vertices land in the same bucket
+static unsigned int hashVertex(const GLfloat* v)
+{
+	const unsigned char* bytes = (const unsigned char*)v;
+	unsigned int hash = 2166136261u; //FNV-1a
+	for (size_t i = 0; i < VERTEX_FLOATS * sizeof(GLfloat); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+void weldVertices(const std::vector<GLfloat>& stream, MeshData& out)
+{
+	size_t corners = stream.size() / VERTEX_FLOATS;
+	out.vertices.clear();
+	out.indices.clear();
+	out.indices.reserve(corners);
+
+	//Open addressing table of vertex indices, kept at most half full
+	size_t tableSize = 1;
+	while (tableSize < corners * 2) tableSize *= 2;
+	std::vector<GLuint> table(tableSize, ~0u);
+
+	for (size_t c = 0; c < corners; c++)
+	{
+		const GLfloat* v = &stream[c * VERTEX_FLOATS];
+		size_t slot = hashVertex(v) & (tableSize - 1);
+		while (table[slot] != ~0u && memcmp(&out.vertices[table[slot] * VERTEX_FLOATS], v, VERTEX_FLOATS * sizeof(GLfloat)) != 0)
+		{
+			slot = (slot + 1) & (tableSize - 1);
+		}
+		if (table[slot] == ~0u)
+		{
+			table[slot] = (GLuint)out.vertexCount();
+			out.vertices.insert(out.vertices.end(), v, v + VERTEX_FLOATS);
+		}
+		out.indices.push_back(table[slot]);
+	}
+}
+
+//Forsyth scoring constants, these are the values from the paper
+const int FORSYTH_CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRI_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+static float vertexScore(int cachePosition, int remainingTris)
+{
+	if (remainingTris == 0)
+	{
+		//No triangles left to use this vertex, so it should never be picked
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			//The vertices of the last triangle get a fixed score so we don't favour any of them
+			score = LAST_TRI_SCORE;
+		}
+		else
+		{
+			float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = powf(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+		}
+	}
+
+	//Boost vertices with few triangles left so we don't leave lone triangles behind
+	score += VALENCE_BOOST_SCALE * powf((float)remainingTris, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount)
+{
+	size_t triCount = indices.size() / 3;
+	if (triCount == 0) return;
+
+	//Build vertex to triangle adjacency
+	std::vector<int> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triCount * 3; i++) remaining[indices[i]]++;
+
+	std::vector<size_t> adjOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) adjOffset[v + 1] = adjOffset[v] + remaining[v];
+	std::vector<GLuint> adjTris(triCount * 3);
+	std::vector<size_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+	for (size_t t = 0; t < triCount; t++)
+	{
+		for (int k = 0; k < 3; k++) adjTris[fill[indices[t * 3 + k]]++] = (GLuint)t;
+	}
+
+	std::vector<int> cachePos(vertexCount, -1);
+	std::vector<float> vScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) vScore[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<float> tScore(triCount);
+	std::vector<bool> emitted(triCount, false);
+	for (size_t t = 0; t < triCount; t++)
+	{
+		tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<GLuint> result;
+	result.reserve(triCount * 3);
+
+	std::vector<GLuint> cache, newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	int bestTri = 0;
+	size_t scanCursor = 0; //Where to restart the linear search when the cache runs dry
+	for (size_t n = 0; n < triCount; n++)
+	{
+		if (bestTri < 0)
+		{
+			//Nothing connected to the cache, take the next triangle we haven't drawn
+			while (emitted[scanCursor]) scanCursor++;
+			bestTri = (int)scanCursor;
+		}
+
+		//Emit the triangle and remove it from its vertices' adjacency lists
+		emitted[bestTri] = true;
+		newCache.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint v = indices[bestTri * 3 + k];
+			result.push_back(v);
+			newCache.push_back(v);
+
+			size_t begin = adjOffset[v];
+			size_t end = begin + remaining[v];
+			for (size_t a = begin; a < end; a++)
+			{
+				if (adjTris[a] == (GLuint)bestTri)
+				{
+					std::swap(adjTris[a], adjTris[end - 1]);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		//The new triangle's vertices move to the front of the LRU cache
+		for (size_t c = 0; c < cache.size(); c++)
+		{
+			GLuint v = cache[c];
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2]) newCache.push_back(v);
+		}
+		for (size_t c = FORSYTH_CACHE_SIZE; c < newCache.size(); c++)
+		{
+			//Evicted, score it as out of cache
+			cachePos[newCache[c]] = -1;
+			vScore[newCache[c]] = vertexScore(-1, remaining[newCache[c]]);
+		}
+		if (newCache.size() > (size_t)FORSYTH_CACHE_SIZE) newCache.resize(FORSYTH_CACHE_SIZE);
+		for (size_t c = 0; c < newCache.size(); c++)
+		{
+			cachePos[newCache[c]] = (int)c;
+			vScore[newCache[c]] = vertexScore((int)c, remaining[newCache[c]]);
+		}
+		cache.swap(newCache);
+
+		//Rescore the triangles touching the cache and pick the best one for next time
+		bestTri = -1;
+		float bestScore = -1.0f;
+		for (size_t c = 0; c < cache.size(); c++)
+		{
+			GLuint v = cache[c];
+			for (size_t a = adjOffset[v]; a < adjOffset[v] + remaining[v]; a++)
+			{
+				GLuint t = adjTris[a];
+				tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+				if (tScore[t] > bestScore)
+				{
+					bestScore = tScore[t];
+					bestTri = (int)t;
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<GLfloat>& vertices, float threshold)
+{
+	size_t triCount = indices.size() / 3;
+	size_t vertexCount = vertices.size() / VERTEX_FLOATS;
+	if (triCount < 2) return;
+
+	//Split into clusters wherever a triangle misses the cache on all three vertices,
+	//which is where the cache optimiser ran out of neighbours and restarted
+	std::vector<size_t> clusterStart;
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = ACMR_CACHE_SIZE + 1;
+	for (size_t t = 0; t < triCount; t++)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint v = indices[t * 3 + k];
+			if (time - timestamps[v] > (unsigned int)ACMR_CACHE_SIZE)
+			{
+				timestamps[v] = time++;
+				misses++;
+			}
+		}
+		if (t == 0 || misses == 3) clusterStart.push_back(t);
+	}
+	size_t clusterCount = clusterStart.size();
+	if (clusterCount < 2) return;
+	clusterStart.push_back(triCount);
+
+	//Area weighted centroid and normal of each cluster, and of the whole mesh
+	std::vector<float> centroid(clusterCount * 3, 0.0f);
+	std::vector<float> normal(clusterCount * 3, 0.0f);
+	std::vector<float> area(clusterCount, 0.0f);
+	float meshCentroid[3] = { 0, 0, 0 };
+	float meshArea = 0;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+		{
+			const GLfloat* p0 = &vertices[indices[t * 3] * VERTEX_FLOATS];
+			const GLfloat* p1 = &vertices[indices[t * 3 + 1] * VERTEX_FLOATS];
+			const GLfloat* p2 = &vertices[indices[t * 3 + 2] * VERTEX_FLOATS];
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; k++)
+			{
+				float mid = (p0[k] + p1[k] + p2[k]) / 3.0f;
+				centroid[c * 3 + k] += mid * a;
+				normal[c * 3 + k] += n[k];
+				meshCentroid[k] += mid * a;
+			}
+			area[c] += a;
+			meshArea += a;
+		}
+	}
+	if (meshArea > 0)
+	{
+		for (int k = 0; k < 3; k++) meshCentroid[k] /= meshArea;
+	}
+
+	//Clusters facing away from the middle of the mesh are likely to occlude the rest, so draw them first
+	std::vector<float> sortKey(clusterCount);
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float len = sqrtf(normal[c * 3] * normal[c * 3] + normal[c * 3 + 1] * normal[c * 3 + 1] + normal[c * 3 + 2] * normal[c * 3 + 2]);
+		float dot = 0;
+		if (area[c] > 0 && len > 0)
+		{
+			for (int k = 0; k < 3; k++) dot += (centroid[c * 3 + k] / area[c] - meshCentroid[k]) * normal[c * 3 + k] / len;
+		}
+		sortKey[c] = dot;
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKey](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+	for (size_t i = 0; i < clusterCount; i++)
+	{
+		size_t c = order[i];
+		result.insert(result.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+	}
+
+	//Keep the reordering only if it didn't cost too much vertex cache efficiency
+	if (computeACMR(result, vertexCount, ACMR_CACHE_SIZE) <= computeACMR(indices, vertexCount, ACMR_CACHE_SIZE) * threshold)
+	{
+		indices.swap(result);
+	}
+}
+
+void optimizeVertexFetch(MeshData& mesh)
+{
+	std::vector<GLuint> remap(mesh.vertexCount(), ~0u);
+	std::vector<GLfloat> result;
+	result.reserve(mesh.vertices.size());
+
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		GLuint v = mesh.indices[i];
+		if (remap[v] == ~0u)
+		{
+			remap[v] = (GLuint)(result.size() / VERTEX_FLOATS);
+			result.insert(result.end(), mesh.vertices.begin() + v * VERTEX_FLOATS, mesh.vertices.begin() + (v + 1) * VERTEX_FLOATS);
+		}
+		mesh.indices[i] = remap[v];
+	}
+	//Vertices no triangle uses are dropped here
+	mesh.vertices.swap(result);
+}
+
+float computeACMR(const std::vector<GLuint>& indices, size_t vertexCount, int cacheSize)
+{
+	size_t triCount = indices.size() / 3;
+	if (triCount == 0) return 0.0f;
+
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	size_t misses = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		GLuint v = indices[i];
+		if (time - timestamps[v] > (unsigned int)cacheSize)
+		{
+			timestamps[v] = time++;
+			misses++;
+		}
+	}
+	return (float)misses / (float)triCount;
+}
+
+void optimizeMesh(MeshData& mesh)
+{
+	optimizeVertexCache(mesh.indices, mesh.vertexCount());
+	optimizeOverdraw(mesh.indices, mesh.vertices, 1.05f);
+	optimizeVertexFetch(mesh);
+}
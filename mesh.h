@@ -0,0 +1,116 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stddef.h>
+#include <vector>
+#include <GL/glew.h>
+
+//Number of floats per vertex: position(3), normal(3), colour(3), texcoord(2)
+const int VERTEX_FLOATS = 11;
+
+//Size of the FIFO post-transform cache used when reporting ACMR
+const int ACMR_CACHE_SIZE = 16;
+
+//What a vertex attribute means, matched to a shader input name when linking
+enum vertex_semantic_t { ATTRIB_POSITION, ATTRIB_NORMAL, ATTRIB_COLOUR, ATTRIB_TEXCOORD, ATTRIB_SEMANTIC_COUNT };
+
+//One attribute inside an interleaved vertex
+struct VertexAttribute
+{
+	GLuint semantic;     //vertex_semantic_t
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	GLuint offset;       //Bytes from the start of the vertex
+};
+
+//Interleaved vertex format, describes how a vertex buffer is laid out
+struct VertexLayout
+{
+	int attributeCount;
+	VertexAttribute attributes[ATTRIB_SEMANTIC_COUNT];
+	GLsizei stride;
+};
+
+//Shader input name for each vertex_semantic_t
+extern const char* const VERTEX_SEMANTIC_NAMES[ATTRIB_SEMANTIC_COUNT];
+
+//Options for packVertices(), part of the mesh cache key
+enum vertex_format_t
+{
+	FORMAT_HALF_POSITIONS = 1 //Positions as half floats in [-1,1], undone with the mesh's positionScale/positionOffset
+};
+
+//CPU side mesh, a welded list of unique vertices and a triangle list into it
+struct MeshData
+{
+	std::vector<GLfloat> vertices; //VERTEX_FLOATS floats per vertex
+	std::vector<GLuint> indices;   //3 per triangle
+
+	size_t vertexCount() const { return vertices.size() / VERTEX_FLOATS; }
+};
+
+//GPU side mesh, everything needed to issue a glDrawElements
+struct Mesh
+{
+	GLuint vao;
+	GLuint vbo;
+	GLuint ibo;
+	int numIndices;
+	GLenum indexType; //GL_UNSIGNED_SHORT when every index fits in 16 bits, GL_UNSIGNED_INT otherwise
+	float boundsMin[3]; //Model space axis aligned bounding box
+	float boundsMax[3];
+	float positionScale;     //Stored position * positionScale + positionOffset gives model space
+	float positionOffset[3];
+	VertexLayout layout;
+};
+
+//Vertex buffer contents in a compact format
+struct PackedVertices
+{
+	VertexLayout layout;
+	std::vector<unsigned char> data;
+	float positionScale;
+	float positionOffset[3];
+};
+
+//Quantise vertices into the smallest layout that holds them:
+//  position  float3, or half3 + pad with FORMAT_HALF_POSITIONS  (12 / 8 bytes)
+//  normal    GL_INT_2_10_10_10_REV                               (4 bytes)
+//  texcoord  unorm16 when inside [0,1], half2 otherwise           (4 bytes)
+//  colour    RGBA8, left out when every vertex is white           (0 / 4 bytes)
+void packVertices(const MeshData& mesh, unsigned int formatFlags, PackedVertices& out);
+
+//Point the currently bound VAO's attributes at the bound GL_ARRAY_BUFFER using a layout.
+//Shader inputs the layout doesn't have are disabled and read a constant instead (white for colour).
+void linkVertexLayout(const VertexLayout& layout, GLuint shaderProgram);
+
+//IEEE half float conversion, round to nearest
+GLushort floatToHalf(float value);
+
+//Model space axis aligned bounding box of the vertex positions
+void computeBounds(const MeshData& mesh, float boundsMin[3], float boundsMax[3]);
+
+//Indices in the smallest GL type that holds them, as raw bytes ready for an element buffer
+void packIndices(const MeshData& mesh, std::vector<unsigned char>& out, GLenum& indexType);
+
+//Collapse a non-indexed vertex stream (one vertex per triangle corner) into unique vertices and indices
+void weldVertices(const std::vector<GLfloat>& stream, MeshData& out);
+
+//Reorder triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm)
+void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount);
+
+//Reorder cache friendly clusters of triangles so outward facing ones are drawn first.
+//Clusters are only split where the cache would be cold anyway, so ACMR stays within threshold of the input.
+void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<GLfloat>& vertices, float threshold);
+
+//Renumber vertices in order of first use so vertex fetch walks the buffer linearly
+void optimizeVertexFetch(MeshData& mesh);
+
+//Average cache miss ratio (vertex shader runs per triangle) for a FIFO cache of the given size
+float computeACMR(const std::vector<GLuint>& indices, size_t vertexCount, int cacheSize);
+
+//Run every optimisation above in the order they expect
+void optimizeMesh(MeshData& mesh);
+
+#endif // MESH_H
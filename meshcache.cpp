@@ -0,0 +1,105 @@
+#include "meshcache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool writeMeshCache(const std::string& path, const MeshData& mesh, const PackedVertices& vertices, unsigned long long sourceHash, unsigned int importFlags, unsigned int formatFlags)
+{
+	const VertexLayout& layout = vertices.layout;
+	std::vector<unsigned char> indexBytes;
+	GLenum indexType;
+	packIndices(mesh, indexBytes, indexType);
+
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.importFlags = importFlags;
+	header.attributeCount = layout.attributeCount;
+	header.stride = layout.stride;
+	header.vertexCount = (unsigned int)mesh.vertexCount();
+	header.indexCount = (unsigned int)mesh.indices.size();
+	header.indexType = indexType;
+	header.formatFlags = formatFlags;
+	computeBounds(mesh, header.boundsMin, header.boundsMax);
+	header.positionScale = vertices.positionScale;
+	for (int k = 0; k < 3; k++) header.positionOffset[k] = vertices.positionOffset[k];
+	header.vertexOffset = sizeof(MeshCacheHeader) + layout.attributeCount * sizeof(MeshCacheAttribute);
+	header.indexOffset = header.vertexOffset + vertices.data.size();
+	//Keep the index blob aligned to its type
+	header.indexOffset = (header.indexOffset + 3) & ~3ull;
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL) return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (int i = 0; i < layout.attributeCount && ok; i++)
+	{
+		const VertexAttribute& a = layout.attributes[i];
+		MeshCacheAttribute record = { a.semantic, (unsigned int)a.components, a.type, a.normalized, a.offset };
+		ok = fwrite(&record, sizeof(record), 1, file) == 1;
+	}
+	if (ok && !vertices.data.empty()) ok = fwrite(&vertices.data[0], 1, vertices.data.size(), file) == vertices.data.size();
+	unsigned char padding[4] = { 0, 0, 0, 0 };
+	size_t paddingSize = (size_t)(header.indexOffset - header.vertexOffset - vertices.data.size());
+	if (ok && paddingSize) ok = fwrite(padding, 1, paddingSize, file) == paddingSize;
+	if (ok && !indexBytes.empty()) ok = fwrite(&indexBytes[0], 1, indexBytes.size(), file) == indexBytes.size();
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+	{
+		//Never leave a half written cache behind
+		remove(path.c_str());
+	}
+	return ok;
+}
+
+//Only what packVertices() writes, anything else came from a corrupt or stale file
+static bool validAttribute(const MeshCacheAttribute& a, unsigned int stride)
+{
+	if (a.semantic >= ATTRIB_SEMANTIC_COUNT || a.components < 1 || a.components > 4 || a.offset >= stride) return false;
+	return a.type == GL_FLOAT || a.type == GL_HALF_FLOAT || a.type == GL_INT_2_10_10_10_REV || a.type == GL_UNSIGNED_SHORT || a.type == GL_UNSIGNED_BYTE;
+}
+
+MeshCacheFile::MeshCacheFile()
+{
+	header = NULL;
+	memset(&layout, 0, sizeof(layout));
+}
+
+bool MeshCacheFile::open(const std::string& path, unsigned long long sourceHash, unsigned int importFlags, unsigned int formatFlags)
+{
+	header = NULL;
+	if (!mapping.open(path)) return false;
+	if (mapping.getLength() < sizeof(MeshCacheHeader)) return false;
+
+	const MeshCacheHeader* h = (const MeshCacheHeader*)mapping.getData();
+	if (h->magic != MESH_CACHE_MAGIC || h->version != MESH_CACHE_VERSION) return false;
+	if (h->sourceHash != sourceHash || h->importFlags != importFlags || h->formatFlags != formatFlags) return false;
+	if (h->attributeCount > ATTRIB_SEMANTIC_COUNT) return false;
+	if (h->indexType != GL_UNSIGNED_SHORT && h->indexType != GL_UNSIGNED_INT) return false;
+
+	//Make sure the attribute records and the blobs the header points at are actually in the file
+	unsigned long long attributeEnd = sizeof(MeshCacheHeader) + (unsigned long long)h->attributeCount * sizeof(MeshCacheAttribute);
+	if (attributeEnd > h->vertexOffset || attributeEnd > mapping.getLength()) return false;
+	unsigned long long indexSize = (unsigned long long)h->indexCount * (h->indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+	if (h->vertexOffset + (unsigned long long)h->vertexCount * h->stride > h->indexOffset) return false;
+	if (h->indexOffset + indexSize > mapping.getLength()) return false;
+
+	const MeshCacheAttribute* records = (const MeshCacheAttribute*)(mapping.getData() + sizeof(MeshCacheHeader));
+	for (unsigned int i = 0; i < h->attributeCount; i++)
+	{
+		if (!validAttribute(records[i], h->stride)) return false;
+	}
+	layout.attributeCount = h->attributeCount;
+	layout.stride = h->stride;
+	for (unsigned int i = 0; i < h->attributeCount; i++)
+	{
+		VertexAttribute a = { records[i].semantic, (GLint)records[i].components, records[i].type, (GLboolean)records[i].normalized, records[i].offset };
+		layout.attributes[i] = a;
+	}
+
+	header = h;
+	return true;
+}
@@ -0,0 +1,74 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <string>
+#include "filemapping.h"
+#include "mesh.h"
+
+//Binary mesh cache, written the first time an .obj is imported and memory mapped on later runs.
+//
+//File layout, all little endian:
+//  MeshCacheHeader
+//  MeshCacheAttribute[attributeCount]  (the vertex layout)
+//  vertex blob at vertexOffset         (vertexCount * stride bytes)
+//  index blob at indexOffset           (indexCount indices of indexType)
+
+const unsigned int MESH_CACHE_MAGIC = 0x48534D50; // "PMSH"
+const unsigned int MESH_CACHE_VERSION = 2;        //Bump whenever loadMesh() or optimizeMesh() output changes
+
+struct MeshCacheHeader
+{
+	unsigned long long sourceHash; //hashFile() of the source mesh
+	unsigned long long vertexOffset;
+	unsigned long long indexOffset;
+	unsigned int magic;
+	unsigned int version;
+	unsigned int importFlags;      //Assimp post processing flags the data was imported with
+	unsigned int attributeCount;
+	unsigned int stride;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int indexType;
+	unsigned int formatFlags;      //vertex_format_t flags the vertices were packed with
+	unsigned int reserved;
+	float boundsMin[3];
+	float boundsMax[3];
+	float positionScale;
+	float positionOffset[3];
+};
+
+struct MeshCacheAttribute
+{
+	unsigned int semantic;
+	unsigned int components;
+	unsigned int type;
+	unsigned int normalized;
+	unsigned int offset;
+};
+
+//Write a mesh's indices, bounds and packed vertices out in the cache format, false if the file couldn't be written
+bool writeMeshCache(const std::string& path, const MeshData& mesh, const PackedVertices& vertices, unsigned long long sourceHash, unsigned int importFlags, unsigned int formatFlags);
+
+//A mapped cache file whose vertex and index blobs can be handed straight to glBufferData
+class MeshCacheFile
+{
+protected:
+	FileMapping mapping;
+	const MeshCacheHeader* header;
+	VertexLayout layout;
+
+public:
+	MeshCacheFile();
+
+	//Map the file and check it matches the source hash, import and vertex format flags, and file format version
+	bool open(const std::string& path, unsigned long long sourceHash, unsigned int importFlags, unsigned int formatFlags);
+
+	const MeshCacheHeader& getHeader() const { return *header; }
+	const VertexLayout& getLayout() const { return layout; }
+	const void* getVertexData() const { return mapping.getData() + header->vertexOffset; }
+	size_t getVertexBytes() const { return (size_t)header->vertexCount * header->stride; }
+	const void* getIndexData() const { return mapping.getData() + header->indexOffset; }
+	size_t getIndexBytes() const { return (size_t)header->indexCount * (header->indexType == GL_UNSIGNED_SHORT ? 2 : 4); }
+};
+
+#endif // MESHCACHE_H
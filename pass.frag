@@ -1,12 +1,19 @@
-#version 330 core
-
-in vec2 UV;
-
-out vec3 color;
-
-uniform sampler2D renderedTexture;
-
-void main()
-{
-	color = texture( renderedTexture, UV ).xyz ;
+#version 330 core
+
+in vec2 UV;
+
+out vec3 color;
+
+uniform sampler2D renderedTexture;
+uniform vec2 texelSize;
+
+//EFFECTS
+//PostChain puts the effect functions here, and defines FETCH to read a texel of the
+//previous stage and APPLY to run the per pixel effects fused into this one
+
+void main()
+{
+	vec3 c = FETCH( renderedTexture, UV );
+	APPLY( c, UV )
+	color = c;
 }
\ No newline at end of file
@@ -0,0 +1,360 @@
+//Physics throughput benchmark, built on its own from the physics sources with no GL (see README.TXT).
+//
+//  physicsbench [scenes] [body counts] [steps] [thread counts]
+//
+//scenes is a comma separated list of stack, pile and mixed, or all (the default):
+//  stack  10 high towers of boxes resting on each other
+//  pile   spheres dropped in layers into a pit, so most end up touching several others
+//  mixed  boxes, long boxes and spheres of two sizes dropped together
+//Every scene stands on a PLANE floor inside four PLANE walls, spaced to fit the body count.
+//body counts is a comma separated list, 100,1000,10000,50000 by default. Each scene is built at each count,
+//stepped 60 times to settle, then timed over steps (300 by default) fixed 1/120s steps at each of thread counts, a comma
+//separated list (1 by default, 0 is one per core). 1 is the single threaded world, anything else the multithreaded one,
+//all run on the same worker threads so a long run never uses up Bullet's per thread slots.
+//Results go to the console and physicsbench.txt: steps per second and step time percentiles, where each step's
+//time went by Bullet's own profile zones, and the memory Bullet allocated.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <math.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <btBulletDynamicsCommon.h>
+#include <LinearMath/btAlignedAllocator.h>
+#include <LinearMath/btQuickprof.h>
+
+#include "physicsbodies.h"
+#include "physicsworld.h"
+#include "shapecache.h"
+#include "taskscheduler.h"
+
+const double BENCH_STEP = 1.0 / 120.0; //The same fixed step the demo's physics thread takes
+const int BENCH_WARMUP_STEPS = 60;
+
+//Every byte Bullet asks for goes through these, each block carries its size in front of it
+const size_t ALLOCATION_HEADER = 16; //Keeps the block as aligned as malloc's
+static std::atomic<size_t> bulletBytes(0);
+static std::atomic<size_t> bulletPeak(0);
+
+static void* countedAlloc(size_t size)
+{
+	unsigned char* block = (unsigned char*)malloc(size + ALLOCATION_HEADER);
+	if (block == NULL) return NULL;
+	*(size_t*)block = size;
+	size_t now = bulletBytes += size;
+	size_t peak = bulletPeak.load();
+	while (now > peak && !bulletPeak.compare_exchange_weak(peak, now)) {}
+	return block + ALLOCATION_HEADER;
+}
+
+static void countedFree(void* memory)
+{
+	if (memory == NULL) return;
+	unsigned char* block = (unsigned char*)memory - ALLOCATION_HEADER;
+	bulletBytes -= *(size_t*)block;
+	free(block);
+}
+
+//Most the process has ever had resident, in bytes
+static size_t peakResident()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return (size_t)usage.ru_maxrss;
+#else
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+enum bench_scene_t { SCENE_STACK, SCENE_PILE, SCENE_MIXED };
+const char* const SCENE_NAMES[] = { "stack", "pile", "mixed" };
+
+//One of Bullet's profile zones, summed over every timed step
+struct Phase
+{
+	std::string name;
+	int depth;
+	double ms;
+};
+
+struct BenchResult
+{
+	bench_scene_t scene;
+	int bodies;
+	int threads;
+	std::vector<double> stepTimes; //ms
+	std::vector<Phase> phases;     //In the order Bullet's tree first gave them
+	size_t setupBytes;             //Bullet's memory once the scene was built and settled
+	size_t peakBytes;              //and the most it had at once while stepping
+};
+
+//A PLANE's normal is its rotation's z axis: turn z half way round the axis between it and the normal
+static glm::quat facing(glm::vec3 normal)
+{
+	glm::vec3 half = glm::normalize(glm::vec3(0, 0, 1) + normal);
+	return glm::quat(0, half.x, half.y, half.z);
+}
+
+//Floor at z = 0 and walls halfWidth from the middle, all facing in
+static void spawnWalls(PhysicsWorld& world, ShapeCache& shapes, float halfWidth)
+{
+	const glm::vec3 normals[5] = { glm::vec3(0, 0, 1), glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0) };
+	for (int i = 0; i < 5; i++)
+	{
+		//A plane sits 1 along its normal from its body
+		float distance = (i == 0) ? 0 : halfWidth;
+		spawnBody(world, shapes, PLANE, -normals[i] * (distance + 1), facing(normals[i]), glm::vec3(0, 0, 0), 0, -1);
+	}
+}
+
+//count bodies on a square of columns levels high, levels being about how tall the scene is meant to be
+static void spawnScene(PhysicsWorld& world, ShapeCache& shapes, bench_scene_t scene, int count)
+{
+	int levels = (scene == SCENE_STACK) ? 10 : (scene == SCENE_PILE ? 20 : 16);
+	float spacing = (scene == SCENE_STACK) ? 1.5f : (scene == SCENE_PILE ? 1.0f : 1.6f);
+	float levelHeight = (scene == SCENE_STACK) ? 1.0f : (scene == SCENE_PILE ? 1.2f : 1.6f);
+	int side = (int)ceil(sqrt(count / (double)levels));
+	if (side < 1) side = 1;
+	float halfWidth = side * spacing * 0.5f + 1;
+	spawnWalls(world, shapes, halfWidth);
+
+	glm::quat upright(1, 0, 0, 0);
+	for (int i = 0; i < count; i++)
+	{
+		int column = i % (side * side);
+		int level = i / (side * side);
+		glm::vec3 position((column % side - (side - 1) * 0.5f) * spacing, (column / side - (side - 1) * 0.5f) * spacing, 0.5f + level * levelHeight);
+		switch (scene)
+		{
+		case SCENE_STACK:
+			//Touching the box below, so the towers start at rest and the solver holds them up
+			spawnBody(world, shapes, BOX, position, upright, glm::vec3(0.5f, 0.5f, 0.5f), 1, i);
+			break;
+		case SCENE_PILE:
+			//Every other layer sits over the gaps of the one below and rolls off into them
+			if (level % 2) position += glm::vec3(0.5f, 0.5f, 0) * spacing;
+			position.z += 0.5f;
+			spawnBody(world, shapes, SPHERE, position, upright, glm::vec3(0.5f, 0.5f, 0.5f), 1, i);
+			break;
+		case SCENE_MIXED:
+			position.z += 0.5f;
+			if (i % 4 == 0) spawnBody(world, shapes, BOX, position, upright, glm::vec3(0.5f, 0.5f, 0.5f), 1, i);
+			else if (i % 4 == 1) spawnBody(world, shapes, SPHERE, position, upright, glm::vec3(0.5f, 0.5f, 0.5f), 1, i);
+			else if (i % 4 == 2) spawnBody(world, shapes, BOX, position, upright, glm::vec3(0.7f, 0.25f, 0.25f), 2, i);
+			else spawnBody(world, shapes, SPHERE, position, upright, glm::vec3(0.3f, 0.3f, 0.3f), 0.5f, i);
+			break;
+		}
+	}
+}
+
+#ifndef BT_NO_PROFILE
+//Add the zones of the step just taken to phases, each followed by the zones inside it.
+//stepSimulation() clears Bullet's tree each time it is called.
+static void addProfileTimes(CProfileIterator* iterator, const std::string& path, int depth, std::vector<Phase>& phases, std::map<std::string, size_t>& found)
+{
+	int children = 0;
+	for (iterator->First(); !iterator->Is_Done(); iterator->Next()) children++;
+	for (int i = 0; i < children; i++)
+	{
+		//Entering a child loses our place, so walk back to it each time
+		iterator->First();
+		for (int k = 0; k < i; k++) iterator->Next();
+		std::string name = path + "/" + iterator->Get_Current_Name();
+		std::map<std::string, size_t>::iterator known = found.find(name);
+		if (known == found.end())
+		{
+			Phase phase = { iterator->Get_Current_Name(), depth, 0 };
+			known = found.insert(std::make_pair(name, phases.size())).first;
+			phases.push_back(phase);
+		}
+		phases[known->second].ms += iterator->Get_Current_Total_Time();
+
+		iterator->Enter_Child(i);
+		addProfileTimes(iterator, name, depth + 1, phases, found);
+		iterator->Enter_Parent();
+	}
+}
+#endif
+
+//scheduler is shared by every multithreaded run, NULL if Bullet wasn't built with BT_THREADSAFE
+static BenchResult runScene(bench_scene_t scene, int count, int steps, int threads, btITaskScheduler* scheduler)
+{
+	BenchResult result;
+	result.scene = scene;
+	result.bodies = count;
+	result.threads = 1; //Unless the multithreaded world is built
+	size_t baseBytes = bulletBytes;
+	{
+		//No mesh reader, the scenes only use shapes made from their dimensions. Made first so it outlives the bodies.
+		ShapeCache shapes;
+		if (threads != 1 && scheduler != NULL)
+		{
+			scheduler->setNumThreads(threads);
+			result.threads = scheduler->getNumThreads();
+		}
+		PhysicsWorld world(threads, threads != 1 ? scheduler : NULL);
+		world.reserve(count + 5);
+		spawnScene(world, shapes, scene, count);
+		btDiscreteDynamicsWorld* dynamics = world.getWorld();
+		for (int i = 0; i < BENCH_WARMUP_STEPS; i++) dynamics->stepSimulation(BENCH_STEP, 1, BENCH_STEP);
+		result.setupBytes = bulletBytes - baseBytes;
+		bulletPeak = (size_t)bulletBytes;
+
+		std::map<std::string, size_t> found;
+		result.stepTimes.reserve(steps);
+		for (int i = 0; i < steps; i++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			dynamics->stepSimulation(BENCH_STEP, 1, BENCH_STEP);
+			result.stepTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+#ifndef BT_NO_PROFILE
+			CProfileIterator* iterator = CProfileManager::Get_Iterator();
+			addProfileTimes(iterator, "", 0, result.phases, found);
+			CProfileManager::Release_Iterator(iterator);
+#endif
+		}
+		result.peakBytes = bulletPeak - baseBytes;
+		//Bodies, shapes and the world go before the next scene is built
+	}
+	if (bulletBytes != baseBytes) std::cout << "WARNING: " << ((long long)bulletBytes - (long long)baseBytes) << " bytes of Bullet memory outlived the world" << std::endl;
+	return result;
+}
+
+static void printResult(std::ostream& out, const BenchResult& result)
+{
+	std::vector<double> sorted(result.stepTimes);
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0;
+	for (size_t i = 0; i < sorted.size(); i++) total += sorted[i];
+	size_t last = sorted.size() - 1;
+	double mean = total / sorted.size();
+
+	out << std::fixed << std::setprecision(3);
+	out << std::left << std::setw(8) << SCENE_NAMES[result.scene] << std::right << std::setw(8) << result.bodies << std::setw(8) << result.threads
+		<< std::setw(12) << std::setprecision(1) << 1000 / mean << std::setprecision(3)
+		<< std::setw(10) << mean << std::setw(10) << sorted[last * 50 / 100] << std::setw(10) << sorted[last * 99 / 100]
+		<< std::setw(12) << std::setprecision(1) << result.setupBytes / 1048576.0 << std::setw(10) << result.peakBytes / 1048576.0 << std::endl;
+	out << std::setprecision(3);
+	for (size_t i = 0; i < result.phases.size(); i++)
+	{
+		const Phase& phase = result.phases[i];
+		double ms = phase.ms / sorted.size();
+		out << "    " << std::string(phase.depth * 2, ' ') << std::left << std::setw(40 - phase.depth * 2) << phase.name << std::right
+			<< std::setw(10) << ms << " ms" << std::setw(8) << std::setprecision(1) << 100 * ms / mean << "%" << std::setprecision(3) << std::endl;
+	}
+	out << std::defaultfloat;
+}
+
+//"a,b,c" into its parts
+static std::vector<std::string> splitList(const std::string& list)
+{
+	std::vector<std::string> parts;
+	std::istringstream in(list);
+	std::string part;
+	while (std::getline(in, part, ',')) if (!part.empty()) parts.push_back(part);
+	return parts;
+}
+
+int main(int argc, char* argv[])
+{
+	//Before anything in Bullet allocates, so every block it frees was counted on the way out
+	btAlignedAllocSetCustom(countedAlloc, countedFree);
+
+	std::vector<bench_scene_t> scenes;
+	std::vector<std::string> sceneNames = splitList(argc > 1 ? argv[1] : "all");
+	for (size_t i = 0; i < sceneNames.size(); i++)
+	{
+		if (sceneNames[i] == "all")
+		{
+			scenes.push_back(SCENE_STACK);
+			scenes.push_back(SCENE_PILE);
+			scenes.push_back(SCENE_MIXED);
+		}
+		else if (sceneNames[i] == "stack") scenes.push_back(SCENE_STACK);
+		else if (sceneNames[i] == "pile") scenes.push_back(SCENE_PILE);
+		else if (sceneNames[i] == "mixed") scenes.push_back(SCENE_MIXED);
+		else std::cout << "WARNING: no scene called " << sceneNames[i] << ", there's stack, pile and mixed" << std::endl;
+	}
+	std::vector<int> counts;
+	std::vector<std::string> countNames = splitList(argc > 2 ? argv[2] : "100,1000,10000,50000");
+	for (size_t i = 0; i < countNames.size(); i++)
+	{
+		if (atoi(countNames[i].c_str()) > 0) counts.push_back(atoi(countNames[i].c_str()));
+	}
+	int steps = argc > 3 ? atoi(argv[3]) : 300;
+	std::vector<int> threadCounts;
+	std::vector<std::string> threadNames = splitList(argc > 4 ? argv[4] : "1");
+	int maxThreads = 1;
+	for (size_t i = 0; i < threadNames.size(); i++)
+	{
+		int threads = atoi(threadNames[i].c_str());
+		if (threads == 0) threads = (int)std::thread::hardware_concurrency();
+		if (threads < 1) continue;
+		threadCounts.push_back(threads);
+		maxThreads = std::max(maxThreads, threads);
+	}
+	if (scenes.empty() || counts.empty() || steps < 1 || threadCounts.empty())
+	{
+		std::cout << "Usage: physicsbench [stack,pile,mixed|all] [body counts, e.g. 100,1000] [steps] [thread counts, e.g. 1,2,4]" << std::endl;
+		return EXIT_FAILURE;
+	}
+#ifdef BT_NO_PROFILE
+	std::cout << "WARNING: Bullet was built with BT_NO_PROFILE, there are no per phase times" << std::endl;
+#endif
+	btITaskScheduler* scheduler = NULL;
+#if BT_THREADSAFE
+	if (maxThreads > 1) scheduler = new WorkStealingScheduler(maxThreads);
+#endif
+
+	std::ostringstream report;
+	report << "Scene     Bodies Threads     Steps/s   Mean ms    p50 ms    p99 ms    Setup MB   Peak MB" << std::endl;
+	std::cout << report.str();
+	for (size_t s = 0; s < scenes.size(); s++)
+	{
+		for (size_t c = 0; c < counts.size(); c++)
+		{
+			for (size_t t = 0; t < threadCounts.size(); t++)
+			{
+				BenchResult result = runScene(scenes[s], counts[c], steps, threadCounts[t], scheduler);
+				std::ostringstream lines;
+				printResult(lines, result);
+				std::cout << lines.str() << std::flush;
+				report << lines.str();
+			}
+		}
+	}
+	//Every world has put Bullet back on its sequential scheduler by now
+	delete scheduler;
+	std::ostringstream resident;
+	resident << "Peak resident " << std::fixed << std::setprecision(1) << peakResident() / 1048576.0 << " MB" << std::endl;
+	std::cout << resident.str();
+	report << resident.str();
+
+	std::ofstream file("physicsbench.txt");
+	file << report.str();
+	return file ? EXIT_SUCCESS : EXIT_FAILURE;
+}
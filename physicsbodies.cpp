@@ -0,0 +1,48 @@
+#include "physicsbodies.h"
+
+#include "shapecache.h"
+
+static PhysicsHandle makePlane(PhysicsWorld& world, btCollisionShape* groundShape, glm::vec3 position, int index)
+{
+	btVector3 positionBT = btVector3(position.x, position.y, position.z);
+	return world.spawn(groundShape, btTransform(btQuaternion(0, 0, 0, 1), positionBT), 0, index);
+}
+
+static PhysicsHandle makeBox(PhysicsWorld& world, btCollisionShape* boxShape, glm::vec3 position, glm::quat rotation, float mass, int index)
+{
+	btVector3 positionBT = btVector3(position.x, position.y, position.z);
+	btQuaternion rotationBT = btQuaternion(rotation.x, rotation.y, rotation.z);
+	return world.spawn(boxShape, btTransform(rotationBT, positionBT), mass, index);
+}
+
+PhysicsHandle spawnBody(PhysicsWorld& world, ShapeCache& shapes, collision_t type, glm::vec3 position, glm::quat rotation, glm::vec3 size, float mass, int userIndex, const std::string& meshFile)
+{
+	btCollisionShape* shape = NULL;
+	btQuaternion rotationBT = btQuaternion(rotation.x, rotation.y, rotation.z, rotation.w);
+	btVector3 normal = quatRotate(rotationBT, btVector3(0, 0, 1));
+	float scale = size.x > 0 ? size.x : 1;
+	PhysicsHandle handle = NULL_PHYSICS_HANDLE;
+	switch (type)
+	{
+	case PLANE:
+		shape = shapes.getPlane(glm::vec3(normal.x(), normal.y(), normal.z()), 1);
+		handle = makePlane(world, shape, position, userIndex);
+		break;
+	case BOX:
+		shape = shapes.getBox(size);
+		handle = makeBox(world, shape, position, rotation, mass, userIndex);
+		break;
+	case SPHERE:
+		shape = shapes.getSphere(size.x); //Bad, but eh
+		handle = makeBox(world, shape, position, rotation, mass, userIndex);
+		break;
+	case HULL:
+	case MESH:
+		shape = (type == HULL) ? shapes.getHull(meshFile) : shapes.getTriangleMesh(meshFile);
+		//A unit box stands in if the mesh couldn't be read
+		shape = shapes.getScaled(shape != NULL ? shape : shapes.getBox(glm::vec3(0.5f, 0.5f, 0.5f)), scale);
+		handle = makeBox(world, shape, position, rotation, (type == HULL) ? mass : 0, userIndex);
+		break;
+	}
+	return handle;
+}
@@ -0,0 +1,21 @@
+#ifndef PHYSICSBODIES_H
+#define PHYSICSBODIES_H
+
+#include <string>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include "physicsworld.h"
+
+class ShapeCache;
+
+//HULL is a convex hull around the entity's mesh, MESH its exact triangles (static only)
+enum collision_t { PLANE, BOX, SPHERE, HULL, MESH };
+
+//Add a body of the given type with its shape from shapes, the way the scene files describe them:
+//size is the half extents of a BOX, the radius of a SPHERE in x and a uniform scale in x for HULL and MESH,
+//which are made from meshFile. A PLANE faces along rotation's z axis and never moves, nor does a MESH.
+PhysicsHandle spawnBody(PhysicsWorld& world, ShapeCache& shapes, collision_t type, glm::vec3 position, glm::quat rotation, glm::vec3 size, float mass, int userIndex, const std::string& meshFile = "");
+
+#endif // PHYSICSBODIES_H
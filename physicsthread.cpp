@@ -0,0 +1,234 @@
+#include "physicsthread.h"
+
+#include <iostream>
+
+#include <btBulletDynamicsCommon.h>
+
+#include "profiler.h"
+#include "shapecache.h"
+
+static glm::vec3 toGlm(const btVector3& v)
+{
+	return glm::vec3(v.x(), v.y(), v.z());
+}
+
+static btVector3 toBullet(const glm::vec3& v)
+{
+	return btVector3(v.x, v.y, v.z);
+}
+
+PhysicsThread::PhysicsThread(btDynamicsWorld* world, ShapeCache* shapes, const std::vector<btRigidBody*>& bodies, double step, int maxSteps)
+{
+	this->world = world;
+	this->shapes = shapes;
+	this->bodies = bodies;
+	this->step = step;
+	this->maxSteps = maxSteps;
+	profiler = NULL;
+	stepScope = 0;
+	running = false;
+	selected = -99;
+	grabDist = 5;
+	grabScale = 1;
+	aimDirection = glm::vec3(1, 0, 0);
+
+	//So there is something to draw before the first step
+	states.resize(bodies.size());
+	scales.resize(bodies.size(), 1.0f);
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		if (bodies[i] != NULL) scales[i] = shapes->getScale(bodies[i]->getCollisionShape());
+	}
+	storeStates(false);
+	storeStates(true);
+	publish(0, 0);
+}
+
+PhysicsThread::~PhysicsThread()
+{
+	stop();
+}
+
+void PhysicsThread::setProfiler(Profiler* profiler)
+{
+	this->profiler = profiler;
+	if (profiler) stepScope = profiler->addScope("stepSimulation");
+}
+
+void PhysicsThread::start(std::chrono::steady_clock::time_point epoch)
+{
+	if (running) return;
+	this->epoch = epoch;
+	running = true;
+	thread = std::thread(&PhysicsThread::run, this);
+}
+
+void PhysicsThread::stop()
+{
+	running = false;
+	if (thread.joinable()) thread.join();
+}
+
+void PhysicsThread::post(const PhysicsCommand& command)
+{
+	std::lock_guard<std::mutex> lock(commandMutex);
+	commands.push_back(command);
+}
+
+void PhysicsThread::run()
+{
+	if (profiler) profiler->nameThread("Physics");
+	double simTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+	while (running)
+	{
+		double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+		//After a hitch the world slows down for a moment instead of each batch taking longer to catch up than the last
+		if (now - simTime > maxSteps * step) simTime = now - maxSteps * step;
+
+		runCommands();
+		int stepped = 0;
+		std::chrono::steady_clock::time_point batchStart = std::chrono::steady_clock::now();
+		while (now - simTime >= step)
+		{
+			storeStates(true);
+			holdGrabbed();
+			{
+				ProfileScope timeStep(profiler, stepScope);
+				world->stepSimulation(btScalar(step), 0); //0 substeps, step by exactly step
+			}
+			simTime += step;
+			stepped++;
+		}
+		if (stepped > 0)
+		{
+			storeStates(false);
+			publish(simTime, std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count() / stepped);
+		}
+
+		std::this_thread::sleep_until(epoch + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(simTime + step)));
+	}
+}
+
+void PhysicsThread::runCommands()
+{
+	std::deque<PhysicsCommand> pending;
+	{
+		std::lock_guard<std::mutex> lock(commandMutex);
+		pending.swap(commands);
+	}
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		const PhysicsCommand& command = pending[i];
+		switch (command.type)
+		{
+		case PhysicsCommand::PICK:
+			pick(command.origin, command.direction);
+			break;
+		case PhysicsCommand::AIM:
+			aimOrigin = command.origin;
+			aimDirection = command.direction;
+			break;
+		case PhysicsCommand::GRAB_SCALE:
+			grabScale = grabScale * command.factor;
+			grabDist = grabDist * command.factor;
+			break;
+		case PhysicsCommand::GRAB_RESET:
+			grabScale = 1;
+			grabDist = 5;
+			break;
+		}
+	}
+}
+
+//Raytrace from origin, grabbing what it hits or dropping it if it's already held
+void PhysicsThread::pick(const glm::vec3& origin, const glm::vec3& direction)
+{
+	btVector3 from = toBullet(origin);
+	btVector3 to = toBullet(origin + direction*1000.0f);
+	btCollisionWorld::ClosestRayResultCallback RayCallback(from, to);
+	world->rayTest(from, to, RayCallback);
+
+	if (RayCallback.hasHit()) {
+		if (selected == (int)RayCallback.m_collisionObject->getUserIndex())
+		{
+			selected = -99;
+		}
+		else
+		{
+			glm::vec3 objO = toGlm(RayCallback.m_collisionObject->getWorldTransform().getOrigin());
+			grabDist = glm::length(objO - origin);
+			selected = (int)RayCallback.m_collisionObject->getUserIndex();
+			grabScale = (selected >= 0 && selected < (int)scales.size()) ? scales[selected] : 1;
+		}
+		std::cout << "mesh " << selected << std::endl;
+		std::cout << "dist " << grabDist << std::endl;
+	}
+	else
+	{
+		std::cout << "background" << std::endl;
+	}
+}
+
+//Pin the grabbed body in front of the camera, at its grab scale
+void PhysicsThread::holdGrabbed()
+{
+	if (selected < 0 || selected >= (int)bodies.size() || bodies[selected] == NULL) return;
+	btRigidBody* rigid = bodies[selected];
+	glm::vec3 held = aimOrigin + aimDirection*grabDist;
+	rigid->setWorldTransform(btTransform(rigid->getWorldTransform().getRotation(), toBullet(held)));
+	if (scales[selected] != grabScale) rescale(selected, grabScale);
+	rigid->setLinearVelocity(btVector3(0, 0, 0));
+	rigid->setAngularVelocity(btVector3(0, 0, 0));
+	rigid->clearForces();
+	rigid->activate();
+}
+
+//Shapes are shared, so rather than scaling its shape the body is moved onto a scaled copy of it
+void PhysicsThread::rescale(int index, float scale)
+{
+	btRigidBody* rigid = bodies[index];
+	btCollisionShape* shape = shapes->getScaled(rigid->getCollisionShape(), scale);
+	if (shape != rigid->getCollisionShape())
+	{
+		//Out and back in so the broadphase picks up the new bounds and drops contacts with the old shape
+		world->removeRigidBody(rigid);
+		rigid->setCollisionShape(shape);
+		world->addRigidBody(rigid);
+	}
+	scales[index] = scale;
+}
+
+//Copy each body's transform into the before or after half of its state
+void PhysicsThread::storeStates(bool previous)
+{
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		if (bodies[i] == NULL) continue;
+		//The body's own transform rather than its motion state, which some Bullet versions extrapolate
+		const btTransform& transform = bodies[i]->getWorldTransform();
+		btQuaternion r = transform.getRotation();
+		BodyState& state = states[i];
+		if (previous)
+		{
+			state.previousPosition = toGlm(transform.getOrigin());
+			state.previousRotation = glm::quat(r.w(), r.x(), r.y(), r.z());
+		}
+		else
+		{
+			state.position = toGlm(transform.getOrigin());
+			state.rotation = glm::quat(r.w(), r.x(), r.y(), r.z());
+			state.scale = glm::vec3(scales[i], scales[i], scales[i]);
+		}
+	}
+}
+
+void PhysicsThread::publish(double time, double stepTime)
+{
+	PhysicsSnapshot& snapshot = snapshots.getBack();
+	snapshot.bodies = states; //Same size every time, so no allocation after the first few
+	snapshot.time = time;
+	snapshot.selected = selected;
+	snapshot.grabDist = grabDist;
+	snapshot.stepTime = stepTime;
+	snapshots.publish();
+}
@@ -0,0 +1,142 @@
+#ifndef PHYSICSTHREAD_H
+#define PHYSICSTHREAD_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+class btDynamicsWorld;
+class btRigidBody;
+class Profiler;
+class ShapeCache;
+
+//Hands the latest value from one writer thread to one reader thread without locks.
+//The writer fills its back copy and swaps it with the middle one, the reader swaps the middle for its
+//front copy whenever something newer has been published. Neither ever waits on the other.
+template<class T> class TripleBuffer
+{
+protected:
+	static const int FRESH = 4; //Set on middle when it holds something the reader hasn't seen
+
+	T buffers[3];
+	std::atomic<int> middle;
+	int back;  //Writer's
+	int front; //Reader's
+
+public:
+	TripleBuffer() : middle(1), back(0), front(2) {}
+
+	//Writer only
+	T& getBack() { return buffers[back]; }
+	void publish() { back = middle.exchange(back | FRESH) & 3; }
+
+	//Reader only. The newest published value, which stays put until the next call.
+	const T& read()
+	{
+		if (middle.load() & FRESH) front = middle.exchange(front) & 3;
+		return buffers[front];
+	}
+};
+
+//Where a body was before and after the last step
+struct BodyState
+{
+	glm::vec3 previousPosition, position;
+	glm::quat previousRotation, rotation;
+	glm::vec3 scale;
+};
+
+//Every body as of one physics step, indexed like the bodies PhysicsThread was given
+struct PhysicsSnapshot
+{
+	std::vector<BodyState> bodies;
+	double time;    //Seconds after start() the last step brought the world up to
+	int selected;   //User index of the grabbed body, -99 for none
+	float grabDist; //How far in front of the camera it is held
+	double stepTime; //Wall seconds a step took, averaged over the batch that made this snapshot
+};
+
+//Something for the simulation thread to do before its next step
+struct PhysicsCommand
+{
+	enum Type
+	{
+		PICK,       //Grab what the ray from origin along direction hits, or let go of it if it's already held
+		AIM,        //The camera moved, the grabbed body follows origin + direction * grab distance
+		GRAB_SCALE, //Scale the grabbed body and its distance by factor
+		GRAB_RESET  //Back to its own size, 5 units away
+	};
+	Type type;
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float factor;
+};
+
+//Steps a Bullet world in fixed steps on its own thread, so physics overlaps rendering.
+//Once started the world and its bodies belong to that thread: the render thread only reads snapshots
+//and changes things by posting commands.
+class PhysicsThread
+{
+protected:
+	btDynamicsWorld* world;
+	ShapeCache* shapes;
+	std::vector<btRigidBody*> bodies; //NULL where an entity has no body
+	double step;
+	int maxSteps;
+	Profiler* profiler; //Times each stepSimulation when set
+	int stepScope;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	std::chrono::steady_clock::time_point epoch;
+
+	std::deque<PhysicsCommand> commands;
+	std::mutex commandMutex;
+	TripleBuffer<PhysicsSnapshot> snapshots;
+
+	//Simulation thread only
+	std::vector<BodyState> states;
+	std::vector<float> scales; //Each body's uniform scale, from the shape cache
+	int selected;
+	float grabDist, grabScale;
+	glm::vec3 aimOrigin, aimDirection;
+
+	void run();
+	void runCommands();
+	void pick(const glm::vec3& origin, const glm::vec3& direction);
+	void holdGrabbed();
+	void rescale(int index, float scale);
+	void storeStates(bool previous);
+	void publish(double time, double stepTime);
+
+public:
+	//bodies[i] is entity i's body, it, the world and the shape cache the bodies' shapes came from have to
+	//outlive the thread, and only the thread uses them while it runs.
+	//After a hitch only maxSteps steps are run and the rest of the time is dropped.
+	PhysicsThread(btDynamicsWorld* world, ShapeCache* shapes, const std::vector<btRigidBody*>& bodies, double step, int maxSteps);
+	~PhysicsThread();
+
+	//Time every step in profiler's "stepSimulation" scope. Call before start().
+	void setProfiler(Profiler* profiler);
+
+	//Times are measured from epoch, so snapshots line up with the caller's own clock
+	void start(std::chrono::steady_clock::time_point epoch);
+	//Returns once the thread is done with the world
+	void stop();
+
+	//Any thread
+	void post(const PhysicsCommand& command);
+
+	//Render thread only. Stays valid until the next call.
+	const PhysicsSnapshot& latest() { return snapshots.read(); }
+
+	double getStep() const { return step; }
+};
+
+#endif // PHYSICSTHREAD_H
@@ -0,0 +1,143 @@
+#include "physicsworld.h"
+
+#include <iostream>
+
+#include "taskscheduler.h"
+#if BT_THREADSAFE
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#endif
+
+const unsigned int NO_SLOT = 0xFFFFFFFF;
+
+PhysicsWorld::PhysicsWorld(int threads, btITaskScheduler* sharedScheduler)
+{
+	solverPool = NULL;
+	scheduler = NULL;
+	ownsScheduler = false;
+	firstFree = NO_SLOT;
+	live = 0;
+
+	// Build the broadphase
+	broadphase = new btDbvtBroadphase();
+
+#if BT_THREADSAFE
+	if (threads != 1 || sharedScheduler != NULL)
+	{
+		//Narrowphase, islands and solving are split across our own work stealing pool
+		ownsScheduler = (sharedScheduler == NULL);
+		scheduler = ownsScheduler ? new WorkStealingScheduler(threads) : sharedScheduler;
+		btSetTaskScheduler(scheduler);
+
+		// Each thread needs its own pools for contact points and algorithms
+		btDefaultCollisionConstructionInfo cci;
+		cci.m_defaultMaxPersistentManifoldPoolSize = 80000;
+		cci.m_defaultMaxCollisionAlgorithmPoolSize = 80000;
+		collisionConfiguration = new btDefaultCollisionConfiguration(cci);
+		dispatcher = new btCollisionDispatcherMt(collisionConfiguration, 40);
+
+		// One solver per thread, islands are handed to whichever is free. The pool deletes them.
+		std::vector<btConstraintSolver*> threadSolvers;
+		for (int i = 0; i < scheduler->getNumThreads(); i++) threadSolvers.push_back(new btSequentialImpulseConstraintSolverMt());
+		solverPool = new btConstraintSolverPoolMt(&threadSolvers[0], (int)threadSolvers.size());
+		solver = new btSequentialImpulseConstraintSolverMt();
+
+		world = new btDiscreteDynamicsWorldMt(dispatcher, broadphase, (btConstraintSolverPoolMt*)solverPool, solver, collisionConfiguration);
+		world->setGravity(btVector3(0, 0, -9.8));
+		std::cout << "Physics solved on " << scheduler->getNumThreads() << " threads" << std::endl;
+		return;
+	}
+#else
+	if (threads != 1 || sharedScheduler != NULL) std::cout << "WARNING: Bullet was built without BT_THREADSAFE, physics runs on one thread" << std::endl;
+#endif
+
+	// Set up the collision configuration and dispatcher
+	collisionConfiguration = new btDefaultCollisionConfiguration();
+	dispatcher = new btCollisionDispatcher(collisionConfiguration);
+
+	// The actual physics solver
+	solver = new btSequentialImpulseConstraintSolver;
+
+	// The world.
+	world = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration);
+	world->setGravity(btVector3(0, 0, -9.8));
+}
+
+PhysicsWorld::~PhysicsWorld()
+{
+	for (unsigned int i = 0; i < slots.size(); i++)
+	{
+		if (slots[i].body == NULL) continue;
+		PhysicsHandle handle = { i, slots[i].generation };
+		despawn(handle);
+	}
+	//Reverse order of creation, everything the world uses outlives it
+	delete world;
+	delete solverPool;
+	delete solver;
+	delete dispatcher;
+	delete collisionConfiguration;
+	delete broadphase;
+#if BT_THREADSAFE
+	if (scheduler != NULL)
+	{
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+		if (ownsScheduler) delete scheduler;
+	}
+#endif
+}
+
+PhysicsHandle PhysicsWorld::spawn(btCollisionShape* shape, const btTransform& transform, float mass, int userIndex)
+{
+	if (firstFree == NO_SLOT)
+	{
+		Slot slot = { NULL, NULL, 0, NO_SLOT };
+		slots.push_back(slot);
+		firstFree = (unsigned int)slots.size() - 1;
+	}
+	unsigned int index = firstFree;
+	Slot& slot = slots[index];
+	firstFree = slot.nextFree;
+
+	btVector3 inertia(0, 0, 0);
+	if (mass != 0) shape->calculateLocalInertia(mass, inertia); //Triangle meshes can't, and are always static
+	slot.motionState = motionStatePool.create(transform);
+	btRigidBody::btRigidBodyConstructionInfo info(mass, slot.motionState, shape, inertia);
+	slot.body = bodyPool.create(info);
+	slot.body->setUserIndex(userIndex);
+	world->addRigidBody(slot.body);
+	live++;
+
+	PhysicsHandle handle = { index, slot.generation };
+	return handle;
+}
+
+void PhysicsWorld::despawn(PhysicsHandle handle)
+{
+	btRigidBody* body = get(handle);
+	if (body == NULL) return;
+	Slot& slot = slots[handle.index];
+	world->removeRigidBody(body);
+	bodyPool.destroy(body);
+	motionStatePool.destroy(slot.motionState);
+	slot.body = NULL;
+	slot.motionState = NULL;
+	slot.generation++;
+	slot.nextFree = firstFree;
+	firstFree = handle.index;
+	live--;
+}
+
+btRigidBody* PhysicsWorld::get(PhysicsHandle handle) const
+{
+	if (handle.index >= slots.size() || slots[handle.index].generation != handle.generation) return NULL;
+	return slots[handle.index].body;
+}
+
+void PhysicsWorld::reserve(size_t count)
+{
+	bodyPool.reserve(count);
+	motionStatePool.reserve(count);
+	slots.reserve(live + count);
+}
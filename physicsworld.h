@@ -0,0 +1,81 @@
+#ifndef PHYSICSWORLD_H
+#define PHYSICSWORLD_H
+
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+
+#include "pool.h"
+
+class btITaskScheduler;
+
+//Names a body for as long as it exists. Once it is despawned the handle goes stale rather than
+//pointing at whatever reuses the slot.
+struct PhysicsHandle
+{
+	unsigned int index;
+	unsigned int generation;
+};
+
+const PhysicsHandle NULL_PHYSICS_HANDLE = { 0xFFFFFFFF, 0 };
+
+//A Bullet world and everything in it. Bodies and their motion states come out of pools and are tracked in
+//a slot table, so spawning and despawning are O(1) on our side with no heap traffic in the steady state.
+//Destroying it removes every body and frees the world and all its parts.
+//Everything here has to be called from whichever thread is stepping the world.
+class PhysicsWorld
+{
+protected:
+	struct Slot
+	{
+		btRigidBody* body;          //NULL while free
+		btDefaultMotionState* motionState;
+		unsigned int generation;    //Bumped on despawn
+		unsigned int nextFree;
+	};
+
+	btDefaultCollisionConfiguration* collisionConfiguration;
+	btCollisionDispatcher* dispatcher;
+	btBroadphaseInterface* broadphase;
+	btConstraintSolver* solver;     //The one the world is given
+	btConstraintSolver* solverPool; //Multithreaded world only, owns the per thread solvers
+	btDiscreteDynamicsWorld* world;
+	btITaskScheduler* scheduler;
+	bool ownsScheduler;
+
+	ObjectPool<btRigidBody> bodyPool;
+	ObjectPool<btDefaultMotionState> motionStatePool;
+	std::vector<Slot> slots;
+	unsigned int firstFree; //Head of the free slot list, 0xFFFFFFFF when every slot is taken
+	size_t live;
+
+	//Owns the world, so not copyable
+	PhysicsWorld(const PhysicsWorld&);
+	PhysicsWorld& operator=(const PhysicsWorld&);
+
+public:
+	//threads is how many threads the world is solved on, anything but 1 builds the multithreaded world.
+	//Needs Bullet built with BT_THREADSAFE, otherwise it warns and builds the single threaded one.
+	//The world makes its own scheduler unless it's given one, which it then runs on at whatever thread count the
+	//scheduler is set to and leaves alone when destroyed. Bullet never gives back the per thread slots a scheduler's
+	//threads take, so anything making many worlds in a row should share one scheduler between them.
+	PhysicsWorld(int threads = 1, btITaskScheduler* sharedScheduler = NULL);
+	~PhysicsWorld();
+
+	//Add a body with its own motion state starting at transform. Mass 0 makes it static.
+	//The shape isn't owned, and userIndex is what ray tests report for it.
+	PhysicsHandle spawn(btCollisionShape* shape, const btTransform& transform, float mass, int userIndex);
+	//Take a body out of the world and give its memory back. Stale handles are ignored.
+	void despawn(PhysicsHandle handle);
+
+	//NULL for stale handles. The pointer stays good until the body is despawned.
+	btRigidBody* get(PhysicsHandle handle) const;
+
+	//Have room for count more bodies without growing the pools
+	void reserve(size_t count);
+
+	btDiscreteDynamicsWorld* getWorld() const { return world; }
+	size_t size() const { return live; }
+};
+
+#endif // PHYSICSWORLD_H
@@ -0,0 +1,70 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <new>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+
+//Fixed size slots for objects of one type, carved out of big blocks so making and destroying them never
+//goes near the heap once the pool has grown to its working size. Objects never move, and blocks are only
+//freed with the pool. Slots are 16 byte aligned, which is what Bullet's SIMD types ask for.
+template<class T> class ObjectPool
+{
+protected:
+	std::vector<void*> blocks;
+	std::vector<T*> freeSlots;
+	size_t blockSize;
+	size_t live;
+
+	static size_t slotBytes() { return (sizeof(T) + 15) & ~size_t(15); }
+
+	void grow()
+	{
+		unsigned char* block = (unsigned char*)btAlignedAlloc(slotBytes() * blockSize, 16);
+		blocks.push_back(block);
+		//Handed out from the front of the block first
+		for (size_t i = blockSize; i > 0; i--) freeSlots.push_back((T*)(block + (i - 1) * slotBytes()));
+	}
+
+	//Owns the blocks, so not copyable
+	ObjectPool(const ObjectPool&);
+	ObjectPool& operator=(const ObjectPool&);
+
+public:
+	ObjectPool(size_t blockSize = 256) : blockSize(blockSize), live(0) {}
+	//Everything made from the pool has to be destroyed first
+	~ObjectPool()
+	{
+		for (size_t i = 0; i < blocks.size(); i++) btAlignedFree(blocks[i]);
+	}
+
+	template<class... Args> T* create(Args&&... args)
+	{
+		if (freeSlots.empty()) grow();
+		T* slot = freeSlots.back();
+		freeSlots.pop_back();
+		live++;
+		return new (slot) T(std::forward<Args>(args)...);
+	}
+
+	void destroy(T* object)
+	{
+		object->~T();
+		freeSlots.push_back(object);
+		live--;
+	}
+
+	//Make sure count objects can be made without growing
+	void reserve(size_t count)
+	{
+		while (freeSlots.size() < count) grow();
+	}
+
+	size_t size() const { return live; }
+	size_t capacity() const { return blocks.size() * blockSize; }
+};
+
+#endif // POOL_H
@@ -0,0 +1,443 @@
+#include "portal.h"
+
+#include <iostream>
+#include <math.h>
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+const glm::vec3 PLATE_TEX_ORIGIN(0.05f, 1, 1);
+const glm::vec3 PLATE_TEX_U(0, -2, 0);
+const glm::vec3 PLATE_TEX_V(0, 0, -2);
+
+//A corner of the plate's face in clip space, with the texcoord it carries
+struct ClipVertex
+{
+	glm::vec4 position;
+	float u, v;
+};
+
+//Distance of a clip space point inside one of the six clip planes, w+x >= 0, w-x >= 0 and so on
+static float planeDistance(const glm::vec4& p, int plane)
+{
+	float value = p[plane / 2];
+	return (plane & 1) ? p.w - value : p.w + value;
+}
+
+bool portalFootprint(const glm::mat4& viewProj, const glm::mat4& plateModel, int screenWidth, int screenHeight, PortalFootprint& footprint)
+{
+	//The textured face as a quad, wound anticlockwise seen from the front
+	std::vector<ClipVertex> polygon(4);
+	float corners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+	glm::mat4 toClip = viewProj * plateModel;
+	for (int i = 0; i < 4; i++)
+	{
+		glm::vec3 local = PLATE_TEX_ORIGIN + PLATE_TEX_U * corners[i][0] + PLATE_TEX_V * corners[i][1];
+		polygon[i].position = toClip * glm::vec4(local, 1);
+		polygon[i].u = corners[i][0];
+		polygon[i].v = corners[i][1];
+	}
+
+	//Sutherland-Hodgman against each clip plane, which also takes care of anything behind the camera
+	std::vector<ClipVertex> clipped;
+	for (int plane = 0; plane < 6 && !polygon.empty(); plane++)
+	{
+		clipped.clear();
+		for (size_t i = 0; i < polygon.size(); i++)
+		{
+			const ClipVertex& a = polygon[i];
+			const ClipVertex& b = polygon[(i + 1) % polygon.size()];
+			float da = planeDistance(a.position, plane);
+			float db = planeDistance(b.position, plane);
+			if (da >= 0) clipped.push_back(a);
+			if ((da >= 0) != (db >= 0))
+			{
+				float t = da / (da - db);
+				ClipVertex edge;
+				edge.position = a.position + (b.position - a.position) * t;
+				edge.u = a.u + (b.u - a.u) * t;
+				edge.v = a.v + (b.v - a.v) * t;
+				clipped.push_back(edge);
+			}
+		}
+		polygon.swap(clipped);
+	}
+	if (polygon.size() < 3) return false;
+
+	//Seen from behind the winding flips, and the front face can't be seen
+	float area = 0;
+	float uvArea = 0;
+	for (size_t i = 0; i < polygon.size(); i++)
+	{
+		const ClipVertex& a = polygon[i];
+		const ClipVertex& b = polygon[(i + 1) % polygon.size()];
+		area += (a.position.x / a.position.w) * (b.position.y / b.position.w) - (b.position.x / b.position.w) * (a.position.y / a.position.w);
+		uvArea += a.u * b.v - b.u * a.v;
+	}
+	if (area <= 0) return false;
+
+	footprint.left = 1; footprint.right = -1;
+	footprint.bottom = 1; footprint.top = -1;
+	for (size_t i = 0; i < polygon.size(); i++)
+	{
+		const glm::vec4& p = polygon[i].position;
+		footprint.left = fminf(footprint.left, p.x / p.w); footprint.right = fmaxf(footprint.right, p.x / p.w);
+		footprint.bottom = fminf(footprint.bottom, p.y / p.w); footprint.top = fmaxf(footprint.top, p.y / p.w);
+	}
+
+	//Texcoords are linear across the face, so the visible ones are bounded by the clipped corners'
+	footprint.uMin = 1; footprint.uMax = 0;
+	footprint.vMin = 1; footprint.vMax = 0;
+	for (size_t i = 0; i < polygon.size(); i++)
+	{
+		footprint.uMin = fminf(footprint.uMin, polygon[i].u); footprint.uMax = fmaxf(footprint.uMax, polygon[i].u);
+		footprint.vMin = fminf(footprint.vMin, polygon[i].v); footprint.vMax = fmaxf(footprint.vMax, polygon[i].v);
+	}
+
+	//Both areas are doubled by the shoelace sums, and NDC is 2 units across the screen
+	float pixelArea = area / 2 * (screenWidth / 2.0f) * (screenHeight / 2.0f);
+	footprint.idealSize = uvArea > 0 ? sqrtf(pixelArea / (uvArea / 2)) : 0;
+	return true;
+}
+
+PortalRect portalRect(const PortalFootprint& footprint, int size)
+{
+	//Texcoord v picks the row of the render target, the same rows glScissor() counts
+	int x0 = (int)floorf(footprint.uMin * size) - 1, x1 = (int)ceilf(footprint.uMax * size) + 1;
+	int y0 = (int)floorf(footprint.vMin * size) - 1, y1 = (int)ceilf(footprint.vMax * size) + 1;
+	PortalRect rect;
+	rect.x = x0 < 0 ? 0 : x0;
+	rect.y = y0 < 0 ? 0 : y0;
+	rect.width = (x1 > size ? size : x1) - rect.x;
+	rect.height = (y1 > size ? size : y1) - rect.y;
+	return rect;
+}
+
+glm::mat4 portalRectMatrix(const PortalRect& rect, int size)
+{
+	return ndcRectMatrix(2.0f * rect.x / size - 1, 2.0f * (rect.x + rect.width) / size - 1,
+		2.0f * rect.y / size - 1, 2.0f * (rect.y + rect.height) / size - 1);
+}
+
+glm::mat4 ndcRectMatrix(float left, float right, float bottom, float top)
+{
+	//Scale and shift x and y in clip space, so multiplied by w for the shift
+	glm::mat4 m(1.0f);
+	m[0][0] = 2 / (right - left);
+	m[1][1] = 2 / (top - bottom);
+	m[3][0] = -(right + left) / (right - left);
+	m[3][1] = -(top + bottom) / (top - bottom);
+	return m;
+}
+
+glm::mat4 obliqueProjection(const glm::mat4& proj, const glm::vec4& clipPlane)
+{
+	//The clip space corner opposite the plane, taken back to view space
+	glm::vec4 q;
+	q.x = ((clipPlane.x > 0 ? 1.0f : (clipPlane.x < 0 ? -1.0f : 0.0f)) + proj[2][0]) / proj[0][0];
+	q.y = ((clipPlane.y > 0 ? 1.0f : (clipPlane.y < 0 ? -1.0f : 0.0f)) + proj[2][1]) / proj[1][1];
+	q.z = -1;
+	q.w = (1 + proj[2][2]) / proj[3][2];
+
+	//Replace the third row so the near plane is clipPlane and the far plane still goes through q
+	glm::vec4 c = clipPlane * (2 / glm::dot(clipPlane, q));
+	glm::mat4 oblique = proj;
+	oblique[0][2] = c.x;
+	oblique[1][2] = c.y;
+	oblique[2][2] = c.z + 1;
+	oblique[3][2] = c.w;
+	return oblique;
+}
+
+PortalTargetPool::PortalTargetPool(int minSize, int maxSize)
+{
+	this->minSize = minSize;
+	this->maxSize = maxSize;
+	frame = 0;
+	keepFrames = 120;
+}
+
+PortalTargetPool::~PortalTargetPool()
+{
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		glDeleteFramebuffers(1, &targets[i].framebuffer);
+		glDeleteTextures(1, &targets[i].texture);
+		glDeleteRenderbuffers(1, &targets[i].depth);
+	}
+}
+
+int PortalTargetPool::chooseSize(const PortalFootprint& footprint) const
+{
+	int size = minSize;
+	while (size < maxSize && size < footprint.idealSize) size *= 2;
+	return size;
+}
+
+int PortalTargetPool::acquire(int size)
+{
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		if (!targets[i].inUse && targets[i].size == size)
+		{
+			targets[i].inUse = true;
+			targets[i].lastUsed = frame;
+			return (int)i;
+		}
+	}
+
+	PortalTarget target;
+	target.size = size;
+	target.lastUsed = frame;
+	target.inUse = true;
+	glGenFramebuffers(1, &target.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	glGenTextures(1, &target.texture);
+	glBindTexture(GL_TEXTURE_2D, target.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, size, size, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glGenRenderbuffers(1, &target.depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, size, size);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.texture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "WARNING: couldn't make a " << size << "x" << size << " portal target" << std::endl;
+		glDeleteFramebuffers(1, &target.framebuffer);
+		glDeleteTextures(1, &target.texture);
+		glDeleteRenderbuffers(1, &target.depth);
+		return -1;
+	}
+	targets.push_back(target);
+	return (int)targets.size() - 1;
+}
+
+void PortalTargetPool::beginFrame()
+{
+	frame++;
+	size_t kept = 0;
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		PortalTarget& target = targets[i];
+		if (frame - target.lastUsed > keepFrames)
+		{
+			glDeleteFramebuffers(1, &target.framebuffer);
+			glDeleteTextures(1, &target.texture);
+			glDeleteRenderbuffers(1, &target.depth);
+			continue;
+		}
+		target.inUse = false;
+		targets[kept++] = target;
+	}
+	targets.resize(kept);
+}
+
+size_t PortalTargetPool::getBytes() const
+{
+	//RGB8 colour plus a 24 bit depth buffer, both usually padded to 4 bytes a texel
+	size_t bytes = 0;
+	for (size_t i = 0; i < targets.size(); i++) bytes += (size_t)targets[i].size * targets[i].size * 8;
+	return bytes;
+}
+
+StencilPortalRenderer::StencilPortalRenderer(int maxDepth, int maxViews)
+{
+	this->maxDepth = maxDepth;
+	this->maxViews = maxViews;
+	views = 0;
+	stats.submitted = 0;
+	stats.culled = 0;
+	scene = NULL;
+	portals = NULL;
+	plate = NULL;
+	program = 0;
+	plateTexture = 0;
+	uniforms = NULL;
+	lights = NULL;
+	width = 0;
+	height = 0;
+}
+
+StencilPortalRenderer::~StencilPortalRenderer()
+{
+	if (!queries.empty()) glDeleteQueries((GLsizei)queries.size(), &queries[0]);
+}
+
+void StencilPortalRenderer::render(Scene& scene, const std::vector<Portal>& portals, const Mesh& plate, GLuint program, GLuint plateTexture,
+	UniformBuffers& uniforms, LightManager& lights, const glm::mat4& view, const glm::mat4& proj, int width, int height)
+{
+	this->scene = &scene;
+	this->portals = &portals;
+	this->plate = &plate;
+	this->program = program;
+	this->plateTexture = plateTexture;
+	this->proj = proj;
+	this->width = width;
+	this->height = height;
+	this->uniforms = &uniforms;
+	this->lights = &lights;
+	views = 0;
+	stats.submitted = 0;
+	stats.culled = 0;
+
+	//Level 0 is everything with stencil 0, so the caller's clear sets it up
+	glEnable(GL_STENCIL_TEST);
+	glStencilMask(0xFF);
+	float screen[4] = { -1, 1, -1, 1 };
+	drawLevel(view, proj, screen, 0);
+	glDisable(GL_STENCIL_TEST);
+
+	//The top level is drawn first now, bin its lights again so they're the ones left bound
+	if (views > 0) uniforms.setPass(view, proj, lights.cluster(view, proj, width, height));
+}
+
+void StencilPortalRenderer::drawPlate(const glm::mat4& view, const glm::mat4& levelProj, const glm::mat4& model)
+{
+	uniforms->setPass(view, levelProj);
+	queue.clear();
+	queue.push(model, *plate, plateTexture, program);
+	queue.submit();
+}
+
+void StencilPortalRenderer::drawLevel(const glm::mat4& view, const glm::mat4& levelProj, float rect[4], int depth)
+{
+	//rect is left, right, bottom, top of the part of the screen this level can cover, in NDC
+	glm::mat4 narrow = ndcRectMatrix(rect[0], rect[1], rect[2], rect[3]);
+	glm::mat4 viewProj = levelProj * view;
+	std::vector<int> candidates;     //Could be looked through, if the level's geometry doesn't hide them
+	std::vector<int> throughPortals; //Drawn as views
+	std::vector<int> platePortals;   //Drawn as plates
+	std::vector<PortalFootprint> footprints;
+
+	for (size_t i = 0; i < portals->size(); i++)
+	{
+		//One seen from behind shows nothing through it, but its plate's back is still there to be drawn
+		PortalFootprint footprint;
+		if (!portalFootprint(narrow * viewProj, (*portals)[i].model, width, height, footprint) || depth >= maxDepth) platePortals.push_back((int)i);
+		else
+		{
+			candidates.push_back((int)i);
+			footprints.push_back(footprint);
+		}
+	}
+
+	//This level's own view first, so the portals can be depth tested against it. Its pixels were left
+	//at the far plane by whoever marked them. Each level sees the lights from its own view.
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	glStencilFunc(GL_EQUAL, depth, 0xFF);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glm::vec4 cluster = lights->cluster(view, levelProj, width, height);
+	uniforms->setPass(view, levelProj, cluster);
+	queue.clear();
+	CullStats levelStats = scene->buildQueue(queue, makeFrustum(narrow * viewProj));
+	for (size_t i = 0; i < platePortals.size(); i++) queue.push((*portals)[platePortals[i]].model, *plate, plateTexture, program);
+	queue.sort();
+	queue.submit();
+	stats.submitted += levelStats.submitted;
+	stats.culled += levelStats.culled;
+	if (candidates.empty()) return;
+
+	//Only portals with a pixel in front of the level's geometry spend a view. All the queries go out
+	//before any is read, so the level waits on the GPU once.
+	while (queries.size() < candidates.size())
+	{
+		GLuint query;
+		glGenQueries(1, &query);
+		queries.push_back(query);
+	}
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, queries[i]);
+		drawPlate(view, levelProj, (*portals)[candidates[i]].model);
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+	std::vector<PortalFootprint> throughFootprints;
+	platePortals.clear();
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		GLuint samples = 0;
+		glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT, &samples);
+		if (samples == 0) continue;
+		if (views >= maxViews) platePortals.push_back(candidates[i]);
+		else
+		{
+			throughPortals.push_back(candidates[i]);
+			throughFootprints.push_back(footprints[i]);
+			views++; //Taken now, so the deeper levels only get what's left
+		}
+	}
+
+	//Past the budget, still with this level's lights bound
+	if (!platePortals.empty())
+	{
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDepthMask(GL_TRUE);
+		uniforms->setPass(view, levelProj, cluster);
+		queue.clear();
+		for (size_t i = 0; i < platePortals.size(); i++) queue.push((*portals)[platePortals[i]].model, *plate, plateTexture, program);
+		queue.submit();
+	}
+
+	for (size_t i = 0; i < throughPortals.size(); i++)
+	{
+		const Portal& portal = (*portals)[throughPortals[i]];
+		const PortalFootprint& footprint = throughFootprints[i];
+
+		//The footprint is inside rect's space, take it back to the whole screen's
+		float child[4];
+		child[0] = rect[0] + (footprint.left + 1) / 2 * (rect[1] - rect[0]);
+		child[1] = rect[0] + (footprint.right + 1) / 2 * (rect[1] - rect[0]);
+		child[2] = rect[2] + (footprint.bottom + 1) / 2 * (rect[3] - rect[2]);
+		child[3] = rect[2] + (footprint.top + 1) / 2 * (rect[3] - rect[2]);
+
+		//Mark the portal's pixels as the next level, only where this level can draw and nothing is in front,
+		//including the planes of the portals already looked through, so the nearer of two overlapping ones wins
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDepthMask(GL_FALSE);
+		glDepthFunc(GL_LESS);
+		glStencilFunc(GL_EQUAL, depth, 0xFF);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+		drawPlate(view, levelProj, portal.model);
+
+		//Push the marked pixels back to the far plane for the next level
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_ALWAYS);
+		glDepthRange(1, 1);
+		glStencilFunc(GL_EQUAL, depth + 1, 0xFF);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+		drawPlate(view, levelProj, portal.model);
+		glDepthRange(0, 1);
+
+		//Step through: come out of the destination's front, facing away from it
+		const Portal& exit = (*portals)[portal.destination];
+		glm::mat4 childView = view * portal.model * glm::rotate(glm::mat4(1.0f), 180.0f, glm::vec3(0, 0, 1)) * glm::inverse(exit.model);
+
+		//Nothing behind the exit can be seen through it
+		glm::vec4 normal = exit.model * glm::vec4(1, 0, 0, 0);
+		glm::vec4 point = exit.model * glm::vec4(PLATE_TEX_ORIGIN, 1);
+		glm::vec4 plane(normal.x, normal.y, normal.z, -(normal.x * point.x + normal.y * point.y + normal.z * point.z));
+		glm::vec4 viewPlane = glm::transpose(glm::inverse(childView)) * plane;
+		drawLevel(childView, obliqueProjection(proj, viewPlane), child, depth + 1);
+
+		//Hand the pixels back to this level with the portal plane's depth, so nothing of this level
+		//behind it is marked later. Only the pixels marked above have depth + 1, so no test is needed.
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_ALWAYS);
+		glStencilFunc(GL_EQUAL, depth + 1, 0xFF);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_DECR);
+		drawPlate(view, levelProj, portal.model);
+	}
+	glDepthFunc(GL_LESS);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
@@ -0,0 +1,156 @@
+#ifndef PORTAL_H
+#define PORTAL_H
+
+#include <stddef.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+
+#include "cull.h"
+#include "mesh.h"
+#include "renderqueue.h"
+#include "scene.h"
+#include "uniforms.h"
+#include "lights.h"
+
+//Where the portal texture lands on plate.obj, in the mesh's (already y/z swapped) space:
+//texcoord (u, v) is at PLATE_TEX_ORIGIN + u * PLATE_TEX_U + v * PLATE_TEX_V, facing +x
+extern const glm::vec3 PLATE_TEX_ORIGIN;
+extern const glm::vec3 PLATE_TEX_U;
+extern const glm::vec3 PLATE_TEX_V;
+
+//The part of a portal's texture that shows on screen, and how many texels across it needs to look sharp
+struct PortalFootprint
+{
+	float uMin, uMax;
+	float vMin, vMax;
+	float idealSize; //Screen pixels per texture side, for the visible part
+	float left, right, bottom, top; //Screen bounds of the visible part, in normalised device coordinates
+};
+
+//Part of a portal's render target, in texels from the lower left
+struct PortalRect
+{
+	int x, y;
+	int width, height;
+};
+
+//Work out what of a portal's texture shows up on a width*height screen when its plate is drawn with
+//plateModel through viewProj. False if none of it does: the plate is off screen, behind the camera or facing away.
+bool portalFootprint(const glm::mat4& viewProj, const glm::mat4& plateModel, int screenWidth, int screenHeight, PortalFootprint& footprint);
+
+//The texels of a size*size target that cover the footprint, with a texel of slack for filtering
+PortalRect portalRect(const PortalFootprint& footprint, int size);
+
+//Maps the part of clip space covered by rect to the whole of it, so a frustum made from
+//portalRectMatrix(rect, size) * viewProj only contains what lands inside rect
+glm::mat4 portalRectMatrix(const PortalRect& rect, int size);
+
+//Same, for a rectangle given in normalised device coordinates
+glm::mat4 ndcRectMatrix(float left, float right, float bottom, float top);
+
+//Move the near plane of a glm::perspective() projection onto clipPlane, given in view space with the camera
+//on its negative side. Everything on the camera's side of the plane is clipped (Lengyel's oblique frustum).
+glm::mat4 obliqueProjection(const glm::mat4& proj, const glm::vec4& clipPlane);
+
+//Colour texture and depth buffer for rendering a portal's view into
+struct PortalTarget
+{
+	GLuint framebuffer;
+	GLuint texture;
+	GLuint depth;
+	int size;
+	int lastUsed; //Frame number
+	bool inUse;   //Handed out this frame
+};
+
+//Power of two portal targets, made when first needed and shared between portals from frame to frame.
+//Targets that go unused for a while are deleted, so memory follows what is on screen.
+class PortalTargetPool
+{
+protected:
+	std::vector<PortalTarget> targets;
+	int minSize, maxSize;
+	int frame;
+	int keepFrames; //How long an unused target is kept around
+
+public:
+	PortalTargetPool(int minSize = 128, int maxSize = 2048);
+	~PortalTargetPool();
+
+	void setSizeLimits(int newMin, int newMax) { minSize = newMin; maxSize = newMax; }
+
+	//Smallest power of two at least footprint.idealSize, within the size limits
+	int chooseSize(const PortalFootprint& footprint) const;
+
+	//Index of a target of exactly size that hasn't been handed out this frame, -1 if one couldn't be made.
+	//Indices are only good until the next beginFrame().
+	int acquire(int size);
+	const PortalTarget& get(int index) const { return targets[index]; }
+
+	//Every target becomes free again, and ones that haven't been used for a while are deleted
+	void beginFrame();
+
+	size_t getBytes() const; //Video memory held, roughly
+	size_t size() const { return targets.size(); }
+};
+
+//One end of a portal pair, looking out of the destination's front
+struct Portal
+{
+	glm::mat4 model; //World transform of its plate
+	int destination; //Index of the portal at the other end
+};
+
+//Draws portals straight into the bound framebuffer, which needs a stencil buffer, instead of into textures.
+//Each portal's view is masked with the stencil buffer and drawn with its near plane on the exit portal,
+//recursing into the portals it can see until maxDepth. Portals past the depth or view budget are drawn as plain plates,
+//portals hidden behind a level's geometry aren't drawn and don't count against the budget.
+class StencilPortalRenderer
+{
+protected:
+	int maxDepth;
+	int maxViews;          //Most views drawn through portals in one frame, across all levels
+	int views;
+	CullStats stats;
+	RenderQueue queue;
+
+	//What render() was given, for drawLevel()
+	Scene* scene;
+	const std::vector<Portal>* portals;
+	const Mesh* plate;
+	GLuint program;
+	GLuint plateTexture;
+	UniformBuffers* uniforms;
+	LightManager* lights;
+	glm::mat4 proj;
+	int width, height;
+	std::vector<GLuint> queries; //Samples passed by each portal of a level, grown as needed
+
+	void drawLevel(const glm::mat4& view, const glm::mat4& levelProj, float rect[4], int depth);
+	void drawPlate(const glm::mat4& view, const glm::mat4& levelProj, const glm::mat4& model);
+
+	//Owns GL queries, so not copyable
+	StencilPortalRenderer(const StencilPortalRenderer&);
+	StencilPortalRenderer& operator=(const StencilPortalRenderer&);
+
+public:
+	StencilPortalRenderer(int maxDepth = 2, int maxViews = 8);
+	~StencilPortalRenderer();
+
+	void setMaxDepth(int depth) { maxDepth = depth; }
+	int getMaxDepth() const { return maxDepth; }
+	void setMaxViews(int count) { maxViews = count; }
+
+	//Draw the scene and its portals from view. plateTexture is what plates are drawn with when not looked through.
+	//Each level and plate gets its own pass from uniforms, the top level's is left bound. Each level bins lights for itself.
+	void render(Scene& scene, const std::vector<Portal>& portals, const Mesh& plate, GLuint program, GLuint plateTexture,
+		UniformBuffers& uniforms, LightManager& lights, const glm::mat4& view, const glm::mat4& proj, int width, int height);
+
+	int getViews() const { return views; }             //Portal views drawn by the last render()
+	const CullStats& getStats() const { return stats; } //Summed over every level of the last render()
+};
+
+#endif // PORTAL_H
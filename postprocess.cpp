@@ -0,0 +1,228 @@
+#include "postprocess.h"
+
+#include <fstream>
+#include <iostream>
+
+const PostEffect POST_VIGNETTE = { "vignette",
+	"vec3 vignette(vec3 colour, vec2 uv)\n"
+	"{\n"
+	"	vec2 d = uv - vec2(0.5);\n"
+	"	return colour * clamp(1.0 - dot(d, d) * 1.5, 0.0, 1.0);\n"
+	"}\n", false };
+
+const PostEffect POST_GREYSCALE = { "greyscale",
+	"vec3 greyscale(vec3 colour, vec2 uv)\n"
+	"{\n"
+	"	return vec3(dot(colour, vec3(0.299, 0.587, 0.114)));\n"
+	"}\n", false };
+
+const PostEffect POST_SHARPEN = { "sharpen",
+	"vec3 sharpen(sampler2D source, vec2 uv)\n"
+	"{\n"
+	"	vec3 c = texture(source, uv).xyz;\n"
+	"	vec3 around = texture(source, uv + vec2(texelSize.x, 0)).xyz + texture(source, uv - vec2(texelSize.x, 0)).xyz\n"
+	"		+ texture(source, uv + vec2(0, texelSize.y)).xyz + texture(source, uv - vec2(0, texelSize.y)).xyz;\n"
+	"	return c + (c * 4.0 - around) * 0.5;\n"
+	"}\n", true };
+
+static std::string readFile(const char* file)
+{
+	std::ifstream in(file);
+	return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+//A colour texture the size of the screen, attached to a new framebuffer
+static void makeTarget(int width, int height, GLuint& framebuffer, GLuint& texture)
+{
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+}
+
+PostChain::PostChain(int width, int height, const char* vertexFile, const char* fragmentFile, ProgramCache& programs)
+{
+	this->programs = &programs;
+	this->width = width;
+	this->height = height;
+	dirty = false;
+	vertexSource = readFile(vertexFile);
+	fragmentTemplate = readFile(fragmentFile);
+	sceneFB = sceneTex = sceneDepth = 0;
+	pingFB[0] = pingFB[1] = 0;
+	pingTex[0] = pingTex[1] = 0;
+	outputFB = 0;
+
+	//The full screen quad, with its attribute pointer set once in the VAO
+	static const GLfloat quad[] =
+	{
+		-1.0f, -1.0f, 0.0f,
+		1.0f, -1.0f, 0.0f,
+		-1.0f,  1.0f, 0.0f,
+		-1.0f,  1.0f, 0.0f,
+		1.0f, -1.0f, 0.0f,
+		1.0f,  1.0f, 0.0f,
+	};
+	glGenVertexArrays(1, &quadVAO);
+	glBindVertexArray(quadVAO);
+	glGenBuffers(1, &quadVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0); //Location 0 in pass.vert
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glBindVertexArray(0);
+}
+
+PostChain::~PostChain()
+{
+	releaseStages();
+	releaseTargets();
+	glDeleteBuffers(1, &quadVBO);
+	glDeleteVertexArrays(1, &quadVAO);
+}
+
+void PostChain::addEffect(const PostEffect& effect)
+{
+	effects.push_back(effect);
+	dirty = true;
+}
+
+void PostChain::clearEffects()
+{
+	effects.clear();
+	dirty = true;
+}
+
+size_t PostChain::stageCount()
+{
+	if (dirty) build();
+	return stages.size();
+}
+
+void PostChain::releaseStages()
+{
+	stages.clear();
+}
+
+void PostChain::releaseTargets()
+{
+	if (sceneFB == 0) return;
+	glDeleteFramebuffers(1, &sceneFB);
+	glDeleteTextures(1, &sceneTex);
+	glDeleteRenderbuffers(1, &sceneDepth);
+	sceneFB = sceneTex = sceneDepth = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		if (pingFB[i] == 0) continue;
+		glDeleteFramebuffers(1, &pingFB[i]);
+		glDeleteTextures(1, &pingTex[i]);
+		pingFB[i] = pingTex[i] = 0;
+	}
+}
+
+void PostChain::build()
+{
+	dirty = false;
+	releaseStages();
+
+	size_t marker = fragmentTemplate.find("//EFFECTS");
+	if (marker == std::string::npos && !effects.empty())
+	{
+		std::cout << "WARNING: post process template has no //EFFECTS line, effects are ignored" << std::endl;
+		releaseTargets();
+		return;
+	}
+
+	//Split into stages: a sampling effect starts a new one, per pixel effects join whatever came before
+	size_t first = 0;
+	while (first < effects.size())
+	{
+		size_t last = first + 1;
+		while (last < effects.size() && !effects[last].sampling) last++;
+
+		std::string inserted;
+		for (size_t i = first; i < last; i++) inserted += effects[i].source;
+		if (effects[first].sampling) inserted += "#define FETCH(source, uv) " + effects[first].name + "(source, uv)\n";
+		else inserted += "#define FETCH(source, uv) texture(source, uv).xyz\n";
+		inserted += "#define APPLY(c, uv)";
+		for (size_t i = effects[first].sampling ? first + 1 : first; i < last; i++) inserted += " c = " + effects[i].name + "(c, uv);";
+		inserted += "\n";
+
+		std::string fragmentSource = fragmentTemplate;
+		fragmentSource.replace(marker, 9, inserted);
+
+		Stage stage;
+		stage.program = programs->getProgram(programs->request("pass", vertexSource, fragmentSource));
+		stages.push_back(stage);
+		first = last;
+	}
+
+	//Every stage compiles at once, then their uniforms can be looked up
+	programs->finish();
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		stages[i].textureLocation = glGetUniformLocation(stages[i].program, "renderedTexture");
+		stages[i].texelSizeLocation = glGetUniformLocation(stages[i].program, "texelSize");
+	}
+
+	//Targets only exist while there is something to run
+	if (stages.empty())
+	{
+		releaseTargets();
+		return;
+	}
+	if (sceneFB == 0)
+	{
+		makeTarget(width, height, sceneFB, sceneTex);
+		glGenRenderbuffers(1, &sceneDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, sceneDepth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, sceneDepth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "WARNING: couldn't make the post process scene target" << std::endl;
+		}
+	}
+	//Stage n reads what stage n-1 wrote, so two are enough however long the chain is
+	for (size_t i = 0; i < 2 && i + 1 < stages.size(); i++)
+	{
+		if (pingFB[i] == 0) makeTarget(width, height, pingFB[i], pingTex[i]);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFB);
+}
+
+GLuint PostChain::getSceneFramebuffer()
+{
+	if (dirty) build();
+	return stages.empty() ? outputFB : sceneFB;
+}
+
+void PostChain::finish()
+{
+	if (dirty) build();
+	if (stages.empty()) return;
+
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(quadVAO);
+	glActiveTexture(GL_TEXTURE0);
+	GLuint source = sceneTex;
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		bool last = i + 1 == stages.size();
+		glBindFramebuffer(GL_FRAMEBUFFER, last ? outputFB : pingFB[i % 2]);
+		glViewport(0, 0, width, height);
+		glUseProgram(stages[i].program);
+		glBindTexture(GL_TEXTURE_2D, source);
+		glUniform1i(stages[i].textureLocation, 0);
+		glUniform2f(stages[i].texelSizeLocation, 1.0f / width, 1.0f / height);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		source = pingTex[i % 2];
+	}
+	glEnable(GL_DEPTH_TEST);
+}
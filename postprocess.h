@@ -0,0 +1,79 @@
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "programcache.h"
+
+//A full screen effect, as a GLSL function spliced into pass.frag
+struct PostEffect
+{
+	std::string name;   //The function's name
+	std::string source; //The function itself
+	//Effects that read neighbouring texels are vec3 name(sampler2D source, vec2 uv) and start a new stage.
+	//The rest are vec3 name(vec3 colour, vec2 uv) and are fused into the stage before them.
+	bool sampling;
+};
+
+//Built in effects
+extern const PostEffect POST_VIGNETTE;
+extern const PostEffect POST_GREYSCALE;
+extern const PostEffect POST_SHARPEN;
+
+//An ordered list of full screen effects. With no effects the scene is drawn straight into the backbuffer,
+//otherwise into an offscreen target, and the effects are fused into as few passes as they can be and run
+//through ping-pong targets with the last one writing the backbuffer.
+class PostChain
+{
+protected:
+	struct Stage
+	{
+		GLuint program;    //Owned by programs, so going back to an earlier chain doesn't compile anything
+		GLint textureLocation;
+		GLint texelSizeLocation;
+	};
+
+	std::vector<PostEffect> effects;
+	std::vector<Stage> stages;
+	bool dirty;        //Effects changed since the stages were built
+	int width, height;
+	std::string vertexSource, fragmentTemplate;
+	ProgramCache* programs;
+
+	GLuint quadVAO, quadVBO;
+	GLuint sceneFB, sceneTex, sceneDepth; //What the scene is drawn into when there are stages
+	GLuint pingFB[2], pingTex[2];         //Between stages
+	GLuint outputFB;                      //Where the last stage writes, the backbuffer unless set
+
+	void build();
+	void releaseStages();
+	void releaseTargets();
+
+public:
+	//The vertex shader and the fragment template effects are spliced into, normally pass.vert and pass.frag.
+	//Stages are built through programs, which has to outlive the chain.
+	PostChain(int width, int height, const char* vertexFile, const char* fragmentFile, ProgramCache& programs);
+	~PostChain();
+
+	void addEffect(const PostEffect& effect);
+	void clearEffects();
+	size_t effectCount() const { return effects.size(); }
+
+	//Number of full screen passes the effects take, once fused
+	size_t stageCount();
+
+	//Stand in for the backbuffer, e.g. with no window. Needs a depth and stencil buffer, 0 is the backbuffer.
+	void setOutputFramebuffer(GLuint framebuffer) { outputFB = framebuffer; }
+
+	//The framebuffer to draw the scene into this frame: the output when there are no effects.
+	//It has a depth and stencil buffer either way.
+	GLuint getSceneFramebuffer();
+
+	//Run the effects over the scene into the output. Does nothing with no effects.
+	void finish();
+};
+
+#endif // POSTPROCESS_H
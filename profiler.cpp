@@ -0,0 +1,217 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <GL/glew.h>
+
+//Events kept while capturing, about 24MB, a minute or so of a busy scene
+const size_t PROFILER_CAPTURE_LIMIT = 1 << 20;
+
+//Which track the calling thread's events go on
+static int currentTrack()
+{
+	static std::atomic<int> nextTrack(PROFILER_GPU_TRACK + 1);
+	static thread_local int track = nextTrack++;
+	return track;
+}
+
+Profiler::Profiler()
+{
+	epoch = std::chrono::steady_clock::now();
+	trackNames.push_back("GPU");
+	for (int i = 0; i < PROFILER_MAX_SCOPES; i++)
+	{
+		cpuCount[i] = 0;
+		gpuCount[i] = 0;
+	}
+	gpuTiming = GLEW_ARB_timer_query != 0;
+	gpuOffset = 0;
+	gpuFrame = 0;
+	gpuMissed = 0;
+	capturing = false;
+	for (int f = 0; f < PROFILER_GPU_FRAMES; f++)
+	{
+		gpuUsed[f] = 0;
+		gpuLast[f] = 0;
+		if (gpuTiming) glGenQueries(PROFILER_GPU_RANGES * 2, &gpuQueries[f][0][0]);
+	}
+	if (gpuTiming) calibrateGpu();
+	nameThread("Render");
+}
+
+Profiler::~Profiler()
+{
+	if (gpuTiming)
+	{
+		for (int f = 0; f < PROFILER_GPU_FRAMES; f++) glDeleteQueries(PROFILER_GPU_RANGES * 2, &gpuQueries[f][0][0]);
+	}
+}
+
+void Profiler::calibrateGpu()
+{
+	//Reading the GPU clock directly goes through the driver, so it's only done now and then
+	GLint64 gpuNow;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	gpuOffset = now() - gpuNow;
+}
+
+int Profiler::addScope(const std::string& name)
+{
+	if (scopeNames.size() >= (size_t)PROFILER_MAX_SCOPES)
+	{
+		std::cout << "WARNING: too many profiler scopes, " << name << " is shared with " << scopeNames.back() << std::endl;
+		return PROFILER_MAX_SCOPES - 1;
+	}
+	scopeNames.push_back(name);
+	return (int)scopeNames.size() - 1;
+}
+
+void Profiler::pushCpu(int scope, long long start, long long end)
+{
+	ProfileEvent event = { start, end, scope, currentTrack() };
+	events.push(event);
+}
+
+void Profiler::nameThread(const std::string& name)
+{
+	int track = currentTrack();
+	std::lock_guard<std::mutex> lock(trackMutex);
+	if ((int)trackNames.size() <= track) trackNames.resize(track + 1);
+	trackNames[track] = name;
+}
+
+void Profiler::beginFrame()
+{
+	ProfileEvent event;
+	while (events.pop(event)) record(event);
+
+	//The set issued PROFILER_GPU_FRAMES frames ago gets reused for this frame
+	gpuFrame = (gpuFrame + 1) % PROFILER_GPU_FRAMES;
+	readGpuFrame(gpuFrame);
+	gpuUsed[gpuFrame] = 0;
+}
+
+void Profiler::readGpuFrame(int frame)
+{
+	if (gpuUsed[frame] == 0) return;
+	//Never wait for results, a frame the GPU hasn't finished yet is dropped rather than stalling the next
+	GLint available = 0;
+	glGetQueryObjectiv(gpuLast[frame], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		gpuMissed++;
+		return;
+	}
+	for (int i = 0; i < gpuUsed[frame]; i++)
+	{
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(gpuQueries[frame][i][0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(gpuQueries[frame][i][1], GL_QUERY_RESULT, &end);
+		ProfileEvent event = { (long long)begin + gpuOffset, (long long)end + gpuOffset, gpuScopes[frame][i], PROFILER_GPU_TRACK };
+		record(event);
+	}
+}
+
+int Profiler::beginGpu(int scope)
+{
+	if (!gpuTiming || gpuUsed[gpuFrame] >= PROFILER_GPU_RANGES) return -1;
+	//Timestamps rather than GL_TIME_ELAPSED, which can't nest and doesn't say where on the timeline a range was
+	int range = gpuUsed[gpuFrame]++;
+	gpuScopes[gpuFrame][range] = scope;
+	glQueryCounter(gpuQueries[gpuFrame][range][0], GL_TIMESTAMP);
+	gpuLast[gpuFrame] = gpuQueries[gpuFrame][range][0];
+	return range;
+}
+
+void Profiler::endGpu(int range)
+{
+	glQueryCounter(gpuQueries[gpuFrame][range][1], GL_TIMESTAMP);
+	gpuLast[gpuFrame] = gpuQueries[gpuFrame][range][1];
+}
+
+void Profiler::record(const ProfileEvent& event)
+{
+	float ms = (event.end - event.start) / 1e6f;
+	if (event.track == PROFILER_GPU_TRACK) gpuSamples[event.scope][gpuCount[event.scope]++ % PROFILER_WINDOW] = ms;
+	else cpuSamples[event.scope][cpuCount[event.scope]++ % PROFILER_WINDOW] = ms;
+	if (capturing && capture.size() < PROFILER_CAPTURE_LIMIT) capture.push_back(event);
+}
+
+ScopeTimes Profiler::percentiles(const float* samples, int count)
+{
+	ScopeTimes times = { 0, 0, 0, std::min(count, PROFILER_WINDOW) };
+	if (times.samples == 0) return times;
+	std::vector<float> sorted(samples, samples + times.samples);
+	std::sort(sorted.begin(), sorted.end());
+	times.p50 = sorted[(times.samples - 1) * 50 / 100];
+	times.p95 = sorted[(times.samples - 1) * 95 / 100];
+	times.p99 = sorted[(times.samples - 1) * 99 / 100];
+	return times;
+}
+
+void Profiler::print(std::ostream& out) const
+{
+	out << "Scope (ms)\t\tCPU p50/p95/p99\t\tGPU p50/p95/p99" << std::endl;
+	out << std::fixed << std::setprecision(3);
+	for (size_t i = 0; i < scopeNames.size(); i++)
+	{
+		ScopeTimes cpu = getCpuTimes((int)i);
+		ScopeTimes gpu = getGpuTimes((int)i);
+		if (cpu.samples == 0 && gpu.samples == 0) continue;
+		out << std::left << std::setw(16) << scopeNames[i] << "\t";
+		if (cpu.samples) out << cpu.p50 << " / " << cpu.p95 << " / " << cpu.p99;
+		else out << "-\t\t";
+		out << "\t";
+		if (gpu.samples) out << gpu.p50 << " / " << gpu.p95 << " / " << gpu.p99;
+		else out << "-";
+		out << std::endl;
+	}
+	out << std::defaultfloat;
+	if (gpuMissed) out << gpuMissed << " GPU frames dropped because their queries weren't ready" << std::endl;
+	if (events.getDropped()) out << events.getDropped() << " CPU events dropped because the ring was full" << std::endl;
+}
+
+void Profiler::startCapture()
+{
+	capture.clear();
+	capturing = true;
+	//Rebase the GPU clock, it drifts against ours over a long run
+	if (gpuTiming) calibrateGpu();
+}
+
+bool Profiler::stopCapture(const std::string& path)
+{
+	capturing = false;
+	std::ofstream file(path.c_str());
+	if (!file) return false;
+
+	//Chrome's trace event format: complete events with times in microseconds, and a name for each track
+	file << "{\"traceEvents\":[";
+	const char* separator = "\n";
+	{
+		std::lock_guard<std::mutex> lock(trackMutex);
+		for (size_t i = 0; i < trackNames.size(); i++)
+		{
+			if (trackNames[i].empty()) continue;
+			file << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"name\":\"" << trackNames[i] << "\"}}";
+			separator = ",\n";
+		}
+	}
+	file << std::fixed << std::setprecision(3);
+	for (size_t i = 0; i < capture.size(); i++)
+	{
+		const ProfileEvent& event = capture[i];
+		file << separator << "{\"name\":\"" << scopeNames[event.scope] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track
+			<< ",\"ts\":" << event.start / 1e3 << ",\"dur\":" << (event.end - event.start) / 1e3 << "}";
+		separator = ",\n";
+	}
+	file << "\n]}" << std::endl;
+	size_t written = capture.size();
+	capture.clear();
+	if (!file) return false;
+	std::cout << "Trace: " << written << " events written to " << path << std::endl;
+	return true;
+}
@@ -0,0 +1,204 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+const int PROFILER_MAX_SCOPES = 32;
+const int PROFILER_WINDOW = 256;         //Latest samples per scope the percentiles are taken over
+const int PROFILER_RING_SIZE = 1 << 14;  //Events in flight between threads and the render thread, a power of two
+const int PROFILER_GPU_FRAMES = 2;       //Query sets in flight, each read back this many frames after it was issued
+const int PROFILER_GPU_RANGES = 32;      //GPU ranges per frame, later ones are ignored
+const int PROFILER_GPU_TRACK = 0;        //Track GPU ranges are shown on, CPU threads are numbered from 1
+
+//Bounded multi producer queue (Vyukov's). Producers never block or take a lock: when the consumer falls this far
+//behind, push() drops the value instead. One consumer only.
+template<class T, int CAPACITY> class EventRing
+{
+protected:
+	struct Slot
+	{
+		std::atomic<size_t> sequence; //Equal to the position it will be written at when free, one past it once written
+		T value;
+	};
+
+	Slot slots[CAPACITY];
+	std::atomic<size_t> writePos;
+	size_t readPos; //Consumer only
+	std::atomic<int> dropped;
+
+	//Owns its slots in place, so not copyable
+	EventRing(const EventRing&);
+	EventRing& operator=(const EventRing&);
+
+public:
+	EventRing() : writePos(0), readPos(0), dropped(0)
+	{
+		for (int i = 0; i < CAPACITY; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	//Any thread. False if the ring was full.
+	bool push(const T& value)
+	{
+		size_t pos = writePos.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Slot& slot = slots[pos & (CAPACITY - 1)];
+			ptrdiff_t lag = (ptrdiff_t)(slot.sequence.load(std::memory_order_acquire) - pos);
+			if (lag == 0)
+			{
+				//Claim the slot, or if another producer got there first try again from where it left writePos
+				if (writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					slot.value = value;
+					slot.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (lag < 0)
+			{
+				//Still holds a value from a lap ago that hasn't been read
+				dropped++;
+				return false;
+			}
+			else pos = writePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	//Consumer only. False once there's nothing left that has been completely written.
+	bool pop(T& value)
+	{
+		Slot& slot = slots[readPos & (CAPACITY - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != readPos + 1) return false;
+		value = slot.value;
+		slot.sequence.store(readPos + CAPACITY, std::memory_order_release);
+		readPos++;
+		return true;
+	}
+
+	int getDropped() const { return dropped; }
+};
+
+//One timed range, in nanoseconds since the profiler was made
+struct ProfileEvent
+{
+	long long start, end;
+	int scope;
+	int track; //PROFILER_GPU_TRACK or the CPU thread it ran on
+};
+
+//Rolling percentiles of one scope, in milliseconds
+struct ScopeTimes
+{
+	float p50, p95, p99;
+	int samples; //How many the percentiles were taken over, 0 if the scope hasn't run
+};
+
+//Where frame time goes. CPU scopes are timed on whichever thread runs them and pushed through a lock free ring,
+//GPU ranges are timestamp queries read back PROFILER_GPU_FRAMES frames later so nothing waits on the GPU.
+//The render thread gathers both once a frame into rolling percentiles per scope and, while capturing,
+//a trace for chrome://tracing. Scopes are added before any other thread starts timing.
+class Profiler
+{
+protected:
+	std::chrono::steady_clock::time_point epoch;
+	std::vector<std::string> scopeNames;
+	EventRing<ProfileEvent, PROFILER_RING_SIZE> events;
+
+	std::vector<std::string> trackNames; //Indexed by track, empty where a thread never named itself
+	std::mutex trackMutex;
+
+	//Render thread only
+	float cpuSamples[PROFILER_MAX_SCOPES][PROFILER_WINDOW];
+	float gpuSamples[PROFILER_MAX_SCOPES][PROFILER_WINDOW];
+	int cpuCount[PROFILER_MAX_SCOPES];
+	int gpuCount[PROFILER_MAX_SCOPES];
+
+	bool gpuTiming;                //ARB_timer_query is there
+	long long gpuOffset;           //Add to a GL timestamp to get our clock
+	unsigned int gpuQueries[PROFILER_GPU_FRAMES][PROFILER_GPU_RANGES][2]; //GL query names, so threads timing the CPU don't need GL headers
+	int gpuScopes[PROFILER_GPU_FRAMES][PROFILER_GPU_RANGES];
+	int gpuUsed[PROFILER_GPU_FRAMES];
+	unsigned int gpuLast[PROFILER_GPU_FRAMES]; //Query issued last in each set, once it's available they all are
+	int gpuFrame;
+	int gpuMissed;                 //Query sets still not ready when their turn came, and dropped
+
+	bool capturing;
+	std::vector<ProfileEvent> capture;
+
+	void calibrateGpu();
+	void readGpuFrame(int frame);
+	void record(const ProfileEvent& event);
+	static ScopeTimes percentiles(const float* samples, int count);
+
+	//Owns GL queries, so not copyable
+	Profiler(const Profiler&);
+	Profiler& operator=(const Profiler&);
+
+public:
+	//On the GL thread
+	Profiler();
+	~Profiler();
+
+	//Returns the scope's id for ProfileScope
+	int addScope(const std::string& name);
+	int getScopeCount() const { return (int)scopeNames.size(); }
+	const std::string& getScopeName(int scope) const { return scopeNames[scope]; }
+
+	//Any thread
+	long long now() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count(); }
+	void pushCpu(int scope, long long start, long long end);
+	//Shown as the calling thread's name in traces
+	void nameThread(const std::string& name);
+
+	//Render thread, at the start of every frame: collect what other threads and the GPU have finished
+	void beginFrame();
+	//Render thread: time the GL commands between these. beginGpu returns what endGpu takes, -1 when not timing.
+	int beginGpu(int scope);
+	void endGpu(int range);
+
+	ScopeTimes getCpuTimes(int scope) const { return percentiles(cpuSamples[scope], cpuCount[scope]); }
+	ScopeTimes getGpuTimes(int scope) const { return percentiles(gpuSamples[scope], gpuCount[scope]); }
+	//Every scope that has run, one line each
+	void print(std::ostream& out) const;
+
+	//Keep every event from now on, until stopCapture() writes them out as Chrome trace JSON
+	void startCapture();
+	bool isCapturing() const { return capturing; }
+	bool stopCapture(const std::string& path);
+};
+
+//Times the enclosing block on the CPU, and on the GPU too if gpu is set, which is only allowed on the render thread.
+//Does nothing with a NULL profiler.
+class ProfileScope
+{
+protected:
+	Profiler* profiler;
+	int scope;
+	int gpuRange;
+	long long start;
+
+	ProfileScope(const ProfileScope&);
+	ProfileScope& operator=(const ProfileScope&);
+
+public:
+	ProfileScope(Profiler* profiler, int scope, bool gpu = false) : profiler(profiler), scope(scope), gpuRange(-1), start(0)
+	{
+		if (!profiler) return;
+		if (gpu) gpuRange = profiler->beginGpu(scope);
+		start = profiler->now();
+	}
+	~ProfileScope()
+	{
+		if (!profiler) return;
+		profiler->pushCpu(scope, start, profiler->now());
+		if (gpuRange >= 0) profiler->endGpu(gpuRange);
+	}
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,274 @@
+#include "programcache.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+static std::string readFile(const char* file)
+{
+	std::ifstream in(file);
+	if (!in) std::cout << "WARNING: couldn't read shader " << file << std::endl;
+	return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+//64 bit FNV-1a, carried on from hash. The terminating zero goes in too, so "ab" "c" and "a" "bc" differ.
+static unsigned long long hashString(unsigned long long hash, const std::string& text)
+{
+	const unsigned char* bytes = (const unsigned char*)text.c_str();
+	for (size_t i = 0; i <= text.size(); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+//Put the defines straight after #version, which has to stay the first thing in the source
+static std::string addDefines(const std::string& source, const std::vector<std::string>& defines)
+{
+	if (defines.empty()) return source;
+	std::string lines;
+	for (size_t i = 0; i < defines.size(); i++) lines += "#define " + defines[i] + "\n";
+	size_t version = source.find("#version");
+	if (version == std::string::npos) return lines + source;
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos) return source + "\n" + lines;
+	return source.substr(0, lineEnd + 1) + lines + source.substr(lineEnd + 1);
+}
+
+static std::string cacheFileName(const std::string& name, unsigned long long key)
+{
+	std::ostringstream fileName;
+	fileName << name << "-" << std::hex << std::setw(16) << std::setfill('0') << key << ".programcache";
+	return fileName.str();
+}
+
+static GLuint compileStage(GLenum type, const std::string& source)
+{
+	const char* text = source.c_str();
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &text, NULL);
+	glCompileShader(shader);
+	return shader;
+}
+
+//Print a stage's log if it didn't compile
+static void checkStage(GLuint shader, const std::string& name, const char* stage)
+{
+	GLint status;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status == GL_TRUE) return;
+	char buffer[512];
+	glGetShaderInfoLog(shader, 512, NULL, buffer);
+	std::cout << "WARNING: " << name << " " << stage << " shader didn't compile" << std::endl << buffer << std::endl;
+}
+
+ProgramCache::ProgramCache()
+{
+	loadedCount = 0;
+	compiledCount = 0;
+
+	const char* vendor = (const char*)glGetString(GL_VENDOR);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+	driver = std::string(vendor ? vendor : "") + "\n" + (renderer ? renderer : "") + "\n" + (version ? version : "");
+
+	GLint formats = 0;
+	if (GLEW_ARB_get_program_binary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	binaries = formats > 0;
+
+	parallel = false;
+#ifdef GL_KHR_parallel_shader_compile
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		parallel = true;
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); //As many as the driver likes
+	}
+#endif
+}
+
+ProgramCache::~ProgramCache()
+{
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].vertexShader) glDeleteShader(entries[i].vertexShader);
+		if (entries[i].fragmentShader) glDeleteShader(entries[i].fragmentShader);
+		glDeleteProgram(entries[i].program);
+	}
+}
+
+int ProgramCache::request(const std::string& name, const std::string& vertexSource, const std::string& fragmentSource,
+	const std::vector<std::string>& defines, const ProgramSetup& setup)
+{
+	std::string vertex = addDefines(vertexSource, defines);
+	std::string fragment = addDefines(fragmentSource, defines);
+	unsigned long long key = hashString(hashString(hashString(14695981039346656037ull, vertex), fragment), driver);
+	for (size_t i = 0; i < attributes.size(); i++)
+	{
+		key = hashString(key, attributes[i].first);
+		key = hashString(key, std::to_string(attributes[i].second));
+	}
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].key == key) return (int)i;
+	}
+
+	Entry entry;
+	entry.name = name;
+	entry.key = key;
+	entry.program = glCreateProgram();
+	entry.vertexShader = 0;
+	entry.fragmentShader = 0;
+	entry.state = LINKING;
+	entry.setup = setup;
+
+	if (loadBinary(entry))
+	{
+		entry.state = READY;
+		loadedCount++;
+		if (entry.setup) entry.setup(entry.program);
+	}
+	else
+	{
+		//Nothing here waits on the driver, that's left for complete()
+		entry.vertexShader = compileStage(GL_VERTEX_SHADER, vertex);
+		entry.fragmentShader = compileStage(GL_FRAGMENT_SHADER, fragment);
+		glAttachShader(entry.program, entry.vertexShader);
+		glAttachShader(entry.program, entry.fragmentShader);
+		for (size_t i = 0; i < attributes.size(); i++) glBindAttribLocation(entry.program, attributes[i].second, attributes[i].first.c_str());
+		glBindFragDataLocation(entry.program, 0, "outColor"); //Ignored by programs with some other single output
+		if (binaries) glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(entry.program);
+	}
+	entries.push_back(entry);
+	return (int)entries.size() - 1;
+}
+
+int ProgramCache::requestFiles(const char* vertexFile, const char* fragmentFile, const std::vector<std::string>& defines, const ProgramSetup& setup)
+{
+	return request(vertexFile, readFile(vertexFile), readFile(fragmentFile), defines, setup);
+}
+
+bool ProgramCache::loadBinary(Entry& entry)
+{
+	if (!binaries) return false;
+	std::string path = cacheFileName(entry.name, entry.key);
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == NULL) return false;
+
+	ProgramCacheHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1;
+	ok = ok && header.magic == PROGRAM_CACHE_MAGIC && header.version == PROGRAM_CACHE_VERSION && header.key == entry.key;
+	std::vector<char> binary(ok ? header.binaryLength : 0);
+	ok = ok && !binary.empty() && fread(&binary[0], 1, binary.size(), file) == binary.size();
+	fclose(file);
+	if (!ok) return false;
+
+	//Drivers turn down their own binaries after an update, even one that kept the version string
+	glProgramBinary(entry.program, header.binaryFormat, &binary[0], (GLsizei)binary.size());
+	GLint linked = GL_FALSE;
+	glGetProgramiv(entry.program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		remove(path.c_str());
+		return false;
+	}
+	return true;
+}
+
+void ProgramCache::saveBinary(const Entry& entry)
+{
+	if (!binaries) return;
+	GLint length = 0;
+	glGetProgramiv(entry.program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(entry.program, length, &length, &format, &binary[0]);
+
+	ProgramCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.key = entry.key;
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.binaryFormat = format;
+	header.binaryLength = (unsigned int)length;
+
+	std::string path = cacheFileName(entry.name, entry.key);
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL) return;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(&binary[0], 1, length, file) == (size_t)length;
+	ok = (fclose(file) == 0) && ok;
+
+	//Never leave a half written cache behind
+	if (!ok) remove(path.c_str());
+}
+
+//Waits on the driver if it hasn't finished linking
+void ProgramCache::complete(Entry& entry)
+{
+	GLint linked = GL_FALSE;
+	glGetProgramiv(entry.program, GL_LINK_STATUS, &linked);
+	if (linked == GL_TRUE)
+	{
+		entry.state = READY;
+		saveBinary(entry);
+	}
+	else
+	{
+		checkStage(entry.vertexShader, entry.name, "vertex");
+		checkStage(entry.fragmentShader, entry.name, "fragment");
+		char buffer[512];
+		glGetProgramInfoLog(entry.program, 512, NULL, buffer);
+		std::cout << "WARNING: " << entry.name << " didn't link" << std::endl << buffer << std::endl;
+		entry.state = FAILED;
+	}
+
+	//The program keeps what it needs, the shader objects are done with
+	glDetachShader(entry.program, entry.vertexShader);
+	glDetachShader(entry.program, entry.fragmentShader);
+	glDeleteShader(entry.vertexShader);
+	glDeleteShader(entry.fragmentShader);
+	entry.vertexShader = 0;
+	entry.fragmentShader = 0;
+	compiledCount++;
+
+	if (entry.state == READY && entry.setup) entry.setup(entry.program);
+}
+
+bool ProgramCache::poll()
+{
+	bool done = true;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].state != LINKING) continue;
+#ifdef GL_KHR_parallel_shader_compile
+		if (parallel)
+		{
+			GLint finished = GL_FALSE;
+			glGetProgramiv(entries[i].program, GL_COMPLETION_STATUS_KHR, &finished);
+			if (finished != GL_TRUE)
+			{
+				done = false;
+				continue;
+			}
+		}
+#endif
+		//Without the extension there's no asking without waiting
+		complete(entries[i]);
+	}
+	return done;
+}
+
+void ProgramCache::finish()
+{
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].state == LINKING) complete(entries[i]);
+	}
+}
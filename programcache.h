@@ -0,0 +1,101 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+
+//Linked program binaries, saved after the first link and loaded instead of compiling on later runs.
+//
+//File layout, <name>-<key>.programcache next to the running program:
+//  ProgramCacheHeader
+//  binary blob        (binaryLength bytes from glGetProgramBinary, in binaryFormat)
+
+const unsigned int PROGRAM_CACHE_MAGIC = 0x47525050; // "PPRG"
+const unsigned int PROGRAM_CACHE_VERSION = 1;        //Bump whenever the way sources are put together changes
+
+struct ProgramCacheHeader
+{
+	unsigned long long key; //programKey() of what the binary was linked from
+	unsigned int magic;
+	unsigned int version;
+	unsigned int binaryFormat;
+	unsigned int binaryLength;
+};
+
+//Called on a program once it has linked, from source or from the cache, e.g. to bind its uniform blocks
+typedef std::function<void(GLuint)> ProgramSetup;
+
+//Every program the renderer uses, by what it was built from. Asking for the same sources and defines twice
+//gives back the same program.
+//
+//Programs are started when asked for and only waited on in poll() or finish(), so with
+//KHR_parallel_shader_compile the driver compiles them all side by side while the caller gets on with something
+//else. A program's name is valid straight away, it just can't be drawn with until it is ready.
+//Must be created and used on the thread that owns the GL context.
+class ProgramCache
+{
+protected:
+	enum program_state_t { LINKING, READY, FAILED };
+
+	struct Entry
+	{
+		std::string name;
+		unsigned long long key;
+		GLuint program;
+		GLuint vertexShader;   //0 once linked, or when loaded from the cache
+		GLuint fragmentShader;
+		program_state_t state;
+		ProgramSetup setup;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<std::pair<std::string, GLuint> > attributes; //Bound before every link
+	std::string driver;   //Vendor, renderer and version, binaries from any other driver are useless
+	bool binaries;        //Whether the driver can hand binaries back at all
+	bool parallel;        //KHR_parallel_shader_compile
+	int loadedCount;      //Programs that came from the cache
+	int compiledCount;    //Programs that were compiled from source
+
+	bool loadBinary(Entry& entry);
+	void saveBinary(const Entry& entry);
+	void complete(Entry& entry);
+
+	//Owns GL programs, so not copyable
+	ProgramCache(const ProgramCache&);
+	ProgramCache& operator=(const ProgramCache&);
+
+public:
+	ProgramCache();
+	~ProgramCache();
+
+	//Every program linked after this has the named vertex attribute at location, so one VAO works with all of them
+	void bindAttribute(const std::string& name, GLuint location) { attributes.push_back(std::make_pair(name, location)); }
+
+	//Start building a program from source text. Each define becomes a "#define <define>" line straight after #version.
+	//name picks the cache file and labels any compile errors. Returns an index for the other functions.
+	int request(const std::string& name, const std::string& vertexSource, const std::string& fragmentSource,
+		const std::vector<std::string>& defines = std::vector<std::string>(), const ProgramSetup& setup = ProgramSetup());
+
+	//The same, reading the sources from files. The cache file is named after the vertex shader.
+	int requestFiles(const char* vertexFile, const char* fragmentFile,
+		const std::vector<std::string>& defines = std::vector<std::string>(), const ProgramSetup& setup = ProgramSetup());
+
+	//Finish off any programs the driver is done with, without waiting. True once nothing is left linking.
+	bool poll();
+
+	//Wait for every program asked for so far
+	void finish();
+
+	GLuint getProgram(int index) const { return entries[index].program; }
+	bool isReady(int index) const { return entries[index].state != LINKING; }
+	bool failed(int index) const { return entries[index].state == FAILED; }
+
+	int getLoadedCount() const { return loadedCount; }
+	int getCompiledCount() const { return compiledCount; }
+};
+
+#endif // PROGRAMCACHE_H
@@ -0,0 +1,122 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+unsigned long long makeSortKey(GLuint program, GLuint texture, GLuint vao)
+{
+	//16 bits of program, 24 of texture, 24 of VAO. GL names are small so nothing is lost in practice.
+	return ((unsigned long long)(program & 0xFFFF) << 48)
+		| ((unsigned long long)(texture & 0xFFFFFF) << 24)
+		| (unsigned long long)(vao & 0xFFFFFF);
+}
+
+void setInstanceModel(GLuint program, const glm::mat4& model)
+{
+	GLint location = glGetAttribLocation(program, "instanceModel");
+	if (location < 0) return;
+	for (int c = 0; c < 4; c++)
+	{
+		//A mat4 attribute takes four consecutive locations, one per column
+		glVertexAttrib4fv(location + c, glm::value_ptr(model[c]));
+	}
+}
+
+RenderQueue::RenderQueue()
+{
+	instanceBuffer = 0;
+	instancing = true;
+	drawCalls = 0;
+}
+
+RenderQueue::~RenderQueue()
+{
+	if (instanceBuffer) glDeleteBuffers(1, &instanceBuffer);
+}
+
+void RenderQueue::push(const glm::mat4& model, const Mesh& mesh, GLuint texture, GLuint program)
+{
+	DrawItem item;
+	item.key = makeSortKey(program, texture, mesh.vao);
+	//Undo the mesh's position quantisation, the scale is uniform so normals are unaffected
+	item.model = glm::translate(model, glm::vec3(mesh.positionOffset[0], mesh.positionOffset[1], mesh.positionOffset[2]));
+	item.model = glm::scale(item.model, glm::vec3(mesh.positionScale));
+	item.mesh = &mesh;
+	item.texture = texture;
+	item.program = program;
+	items.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+	std::stable_sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+}
+
+void RenderQueue::submit()
+{
+	drawCalls = 0;
+	if (items.empty()) return;
+
+	//Every model matrix goes up in one upload, orphaning last submit's storage so we never wait on the GPU
+	instanceData.resize(items.size());
+	for (size_t i = 0; i < items.size(); i++) instanceData[i] = items[i].model;
+	if (instanceBuffer == 0) glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instanceData.size() * sizeof(glm::mat4), &instanceData[0]);
+
+	GLuint currentProgram = 0;
+	GLuint currentTexture = 0;
+	GLuint currentVAO = 0;
+	GLint instanceLocation = -1;
+	size_t first = 0;
+	while (first < items.size())
+	{
+		const DrawItem& item = items[first];
+
+		//Everything after this item with the same key can go in the same draw
+		size_t count = 1;
+		if (instancing)
+		{
+			while (first + count < items.size() && items[first + count].key == item.key) count++;
+		}
+
+		if (item.program != currentProgram || first == 0)
+		{
+			currentProgram = item.program;
+			glUseProgram(currentProgram);
+			std::map<GLuint, GLint>::iterator found = instanceLocations.find(currentProgram);
+			if (found == instanceLocations.end())
+			{
+				found = instanceLocations.insert(std::make_pair(currentProgram, glGetAttribLocation(currentProgram, "instanceModel"))).first;
+			}
+			instanceLocation = found->second;
+		}
+		if (item.texture != currentTexture || first == 0)
+		{
+			currentTexture = item.texture;
+			glBindTexture(GL_TEXTURE_2D, currentTexture);
+		}
+		if (item.mesh->vao != currentVAO || first == 0)
+		{
+			currentVAO = item.mesh->vao;
+			glBindVertexArray(currentVAO);
+		}
+
+		//Point the instance attribute at this batch's matrices. Pointers are VAO state so this is set per batch.
+		if (instanceLocation >= 0)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				glVertexAttribPointer(instanceLocation + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(first * sizeof(glm::mat4) + c * sizeof(glm::vec4)));
+				glEnableVertexAttribArray(instanceLocation + c);
+				glVertexAttribDivisor(instanceLocation + c, 1);
+			}
+		}
+		glDrawElementsInstanced(GL_TRIANGLES, item.mesh->numIndices, item.mesh->indexType, 0, (GLsizei)count);
+		drawCalls++;
+		first += count;
+	}
+}
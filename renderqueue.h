@@ -0,0 +1,61 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+
+#include "mesh.h"
+
+//One draw call waiting to be submitted
+struct DrawItem
+{
+	unsigned long long key; //makeSortKey(), draws with equal state end up next to each other
+	glm::mat4 model;        //Includes the mesh's dequantisation
+	const Mesh* mesh;
+	GLuint texture;
+	GLuint program;
+};
+
+//Most expensive state change in the highest bits: program, then texture, then mesh
+unsigned long long makeSortKey(GLuint program, GLuint texture, GLuint vao);
+
+//Set the model matrix shaders read from the "instanceModel" attribute when no instance buffer is bound,
+//for things drawn outside a RenderQueue. Generic attribute values are context state, not VAO state.
+void setInstanceModel(GLuint program, const glm::mat4& model);
+
+//Collects a pass's draws, sorts them by state and submits them with only the state changes that are needed.
+//Draws sharing a key become one instanced draw, with model matrices streamed into a per-instance buffer.
+class RenderQueue
+{
+protected:
+	std::vector<DrawItem> items;
+	std::vector<glm::mat4> instanceData;        //Model matrices in submission order
+	GLuint instanceBuffer;
+	std::map<GLuint, GLint> instanceLocations;  //"instanceModel" attribute of each program we've seen
+	bool instancing;
+	int drawCalls;
+
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	void clear() { items.clear(); }
+	void push(const glm::mat4& model, const Mesh& mesh, GLuint texture, GLuint program);
+	void sort();
+
+	//Draw everything in order. Leaves the last program, texture and VAO bound.
+	void submit();
+
+	//With instancing off every item gets its own draw call, for comparison
+	void setInstancing(bool enabled) { instancing = enabled; }
+	bool getInstancing() const { return instancing; }
+
+	size_t size() const { return items.size(); }
+	int getDrawCalls() const { return drawCalls; } //Issued by the last submit()
+};
+
+#endif // RENDERQUEUE_H
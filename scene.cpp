@@ -0,0 +1,246 @@
+//Scene files are plain text, one statement per line, '#' starts a comment:
+//
+//  mesh     <name> <file>
+//  texture  <name> <file>
+//  material <name> <texture|->
+//  static   <mesh> <material> pos <x y z> rot <degrees> <ax ay az> scale <x y z>
+//  body     <mesh|-> <material|-> <PLANE|BOX|SPHERE|HULL|MESH> pos <x y z> quat <w x y z> size <x y z> mass <m>
+//           size is the half extents of a BOX, the radius of a SPHERE in x, and for HULL and MESH, which are made
+//           from the body's mesh, a uniform scale in x. MESH bodies never move, whatever their mass.
+//  light    pos <x y z> colour <r g b> radius <r>
+//           A point light, radius 0 works one out from the colour
+//  array    <nx ny nz> <dx dy dz> body|light ...
+//           Repeats the body or light that follows on an nx*ny*nz grid, pos is the first corner and d the spacing
+
+#include "scene.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "glm/gtc/matrix_transform.hpp"
+
+glm::mat4 objectMatrix(glm::vec3 position, float angle, glm::vec3 axis, glm::vec3 scale)
+{
+	glm::mat4 zero;
+	glm::mat4 mCurrent;
+	mCurrent = glm::translate(zero, position);
+	mCurrent = glm::rotate(mCurrent, angle, axis);
+	mCurrent = glm::scale(mCurrent, scale);
+	return mCurrent;
+}
+
+static int findName(const std::vector<std::string>& names, const std::string& name)
+{
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (names[i] == name) return (int)i;
+	}
+	return -1;
+}
+
+int Scene::findMesh(const std::string& name) const { return findName(meshNames, name); }
+int Scene::findTexture(const std::string& name) const { return findName(textureNames, name); }
+int Scene::findMaterial(const std::string& name) const { return findName(materialNames, name); }
+
+//Read "<keyword> <n floats>", false if the keyword doesn't match or a number is missing
+static bool readValues(std::istringstream& in, const char* keyword, float* values, int count)
+{
+	std::string word;
+	in >> word;
+	if (word != keyword) return false;
+	for (int i = 0; i < count; i++)
+	{
+		if (!(in >> values[i])) return false;
+	}
+	return true;
+}
+
+bool Scene::load(const std::string& fileName, AssetLoader& loader, const ShaderVariants& variants)
+{
+	this->variants = &variants;
+	std::ifstream file(fileName.c_str());
+	if (!file)
+	{
+		std::cout << "No scene found! - Looking for " << fileName << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) line.erase(comment);
+
+		std::istringstream in(line);
+		std::string command;
+		if (!(in >> command)) continue; //Blank line
+
+		bool ok = true;
+		int arrayCount[3] = { 1, 1, 1 };
+		float arraySpacing[3] = { 0, 0, 0 };
+		if (command == "array")
+		{
+			ok = (bool)(in >> arrayCount[0] >> arrayCount[1] >> arrayCount[2] >> arraySpacing[0] >> arraySpacing[1] >> arraySpacing[2] >> command);
+			ok = ok && (command == "body" || command == "light") && arrayCount[0] > 0 && arrayCount[1] > 0 && arrayCount[2] > 0;
+			if (!ok) command.clear();
+		}
+
+		if (command == "mesh" || command == "texture")
+		{
+			std::string name, path;
+			ok = (bool)(in >> name >> path);
+			if (ok && command == "mesh")
+			{
+				meshNames.push_back(name);
+				meshes.push_back(loader.loadMesh(path));
+			}
+			else if (ok)
+			{
+				textureNames.push_back(name);
+				textures.push_back(loader.loadTexture(path));
+			}
+		}
+		else if (command == "material")
+		{
+			std::string name, texture;
+			ok = (bool)(in >> name >> texture) && (texture == "-" || findTexture(texture) >= 0);
+			if (ok)
+			{
+				Material material;
+				material.flags = (texture == "-") ? 0 : VARIANT_TEXTURED;
+				if (texture != "-") material.texture = textures[findTexture(texture)];
+				materialNames.push_back(name);
+				materials.push_back(material);
+			}
+		}
+		else if (command == "static" || command == "body")
+		{
+			Entity entity;
+			std::string mesh, material;
+			ok = (bool)(in >> mesh >> material);
+			entity.mesh = (mesh == "-") ? -1 : findMesh(mesh);
+			entity.material = (material == "-") ? -1 : findMaterial(material);
+			ok = ok && (mesh == "-" || entity.mesh >= 0) && (material == "-" || entity.material >= 0);
+			ok = ok && ((entity.mesh < 0) == (entity.material < 0)); //A mesh needs something to draw it with
+			entity.body = NULL;
+			entity.position = glm::vec3(0, 0, 0);
+			entity.angle = 0;
+			entity.axis = glm::vec3(0, 0, 1);
+			entity.scale = glm::vec3(1, 1, 1);
+
+			if (ok && command == "static")
+			{
+				float pos[3], rot[4], scale[3];
+				ok = readValues(in, "pos", pos, 3) && readValues(in, "rot", rot, 4) && readValues(in, "scale", scale, 3);
+				entity.hasBody = false;
+				entity.position = glm::vec3(pos[0], pos[1], pos[2]);
+				entity.angle = rot[0];
+				entity.axis = glm::vec3(rot[1], rot[2], rot[3]);
+				entity.scale = glm::vec3(scale[0], scale[1], scale[2]);
+				entity.model = objectMatrix(entity.position, entity.angle, entity.axis, entity.scale);
+			}
+			else if (ok)
+			{
+				std::string shape;
+				float pos[3], quat[4], size[3];
+				ok = (bool)(in >> shape) && readValues(in, "pos", pos, 3) && readValues(in, "quat", quat, 4)
+					&& readValues(in, "size", size, 3) && readValues(in, "mass", &entity.mass, 1);
+				entity.hasBody = true;
+				if (shape == "PLANE") entity.shape = PLANE;
+				else if (shape == "BOX") entity.shape = BOX;
+				else if (shape == "SPHERE") entity.shape = SPHERE;
+				else if (shape == "HULL") entity.shape = HULL;
+				else if (shape == "MESH") entity.shape = MESH;
+				else ok = false;
+				ok = ok && (entity.mesh >= 0 || (entity.shape != HULL && entity.shape != MESH)); //Those are made from the mesh
+				entity.position = glm::vec3(pos[0], pos[1], pos[2]);
+				entity.rotation = glm::quat(quat[0], quat[1], quat[2], quat[3]);
+				entity.size = glm::vec3(size[0], size[1], size[2]);
+			}
+			for (int x = 0; ok && x < arrayCount[0]; x++)
+			{
+				for (int y = 0; y < arrayCount[1]; y++)
+				{
+					for (int z = 0; z < arrayCount[2]; z++)
+					{
+						Entity copy = entity;
+						copy.position += glm::vec3(x * arraySpacing[0], y * arraySpacing[1], z * arraySpacing[2]);
+						entities.push_back(copy);
+					}
+				}
+			}
+		}
+		else if (command == "light")
+		{
+			float pos[3], colour[3];
+			PointLight light;
+			ok = readValues(in, "pos", pos, 3) && readValues(in, "colour", colour, 3) && readValues(in, "radius", &light.radius, 1);
+			light.position = glm::vec3(pos[0], pos[1], pos[2]);
+			light.colour = glm::vec3(colour[0], colour[1], colour[2]);
+			if (light.radius <= 0) light.radius = lightRadius(light.colour);
+			for (int x = 0; ok && x < arrayCount[0]; x++)
+			{
+				for (int y = 0; y < arrayCount[1]; y++)
+				{
+					for (int z = 0; z < arrayCount[2]; z++)
+					{
+						PointLight copy = light;
+						copy.position += glm::vec3(x * arraySpacing[0], y * arraySpacing[1], z * arraySpacing[2]);
+						lights.push_back(copy);
+					}
+				}
+			}
+		}
+		else if (!command.empty())
+		{
+			ok = false;
+		}
+
+		if (!ok)
+		{
+			std::cout << "WARNING: " << fileName << " : " << lineNumber << " - couldn't understand \"" << line << "\"" << std::endl;
+		}
+	}
+	return true;
+}
+
+void Scene::updateBounds()
+{
+	bounds.resize(entities.size());
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		const Entity& entity = entities[i];
+		//Mesh bounds only exist once it has loaded, buildQueue() skips the rest anyway
+		if (entity.mesh < 0 || !meshes[entity.mesh]->ready) continue;
+		const Mesh& mesh = meshes[entity.mesh]->mesh;
+		bounds.set(i, mesh.boundsMin, mesh.boundsMax, entity.model);
+	}
+}
+
+CullStats Scene::buildQueue(RenderQueue& queue, const Frustum& frustum)
+{
+	CullStats stats = { 0, 0 };
+	if (bounds.size() != entities.size()) updateBounds();
+	bounds.cull(frustum, visible);
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		const Entity& entity = entities[i];
+		if (entity.mesh < 0) continue;
+		const MeshHandle& mesh = meshes[entity.mesh];
+		if (!mesh->ready) continue; //Still loading
+		if (!visible[i])
+		{
+			stats.culled++;
+			continue;
+		}
+
+		const Material& material = materials[entity.material];
+		GLuint program = variants->get(material.flags | meshVariantFlags(mesh->mesh));
+		queue.push(entity.model, mesh->mesh, material.texture ? material.texture->texture : 0, program);
+		stats.submitted++;
+	}
+	return stats;
+}
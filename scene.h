@@ -0,0 +1,87 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include "assetloader.h"
+#include "cull.h"
+#include "lights.h"
+#include "physicsbodies.h"
+#include "renderqueue.h"
+#include "shadervariants.h"
+
+class btRigidBody;
+
+//What a surface is drawn with
+struct Material
+{
+	TextureHandle texture; //Empty for untextured surfaces
+	unsigned int flags;    //VARIANT_* flags, the mesh adds VARIANT_VERTEX_COLOUR if it has colours
+};
+
+//Something in the world. Either may be missing: a collider with no mesh is invisible,
+//a mesh with no body never moves.
+struct Entity
+{
+	int mesh;     //Index into Scene::meshes, -1 for none
+	int material; //Index into Scene::materials
+
+	//Placement of entities without a body
+	glm::vec3 position;
+	float angle;  //Degrees
+	glm::vec3 axis;
+	glm::vec3 scale;
+
+	//Rigid body description, turned into a btRigidBody by whoever owns the physics world
+	bool hasBody;
+	collision_t shape;
+	glm::quat rotation; //Exactly as passed to glm::quat(w, x, y, z)
+	glm::vec3 size;
+	float mass;
+	btRigidBody* body;
+
+	glm::mat4 model; //World transform, refreshed every frame for bodies
+};
+
+//Everything in the world, loaded from a scene file
+class Scene
+{
+public:
+	std::vector<MeshHandle> meshes;
+	std::vector<std::string> meshNames;
+	std::vector<TextureHandle> textures;
+	std::vector<std::string> textureNames;
+	std::vector<Material> materials;
+	std::vector<std::string> materialNames;
+	std::vector<Entity> entities;
+	std::vector<PointLight> lights;    //Fixed lights, on top of whatever the program adds
+	BoundsList bounds;                 //World box of each entity, from updateBounds()
+	std::vector<unsigned char> visible; //Scratch for buildQueue()
+	const ShaderVariants* variants;     //What materials are drawn with, in whatever mode it's set to
+
+	//Read a scene file and start loading the assets it uses. Lines that can't be parsed are skipped with a warning.
+	//Entities are drawn with whichever of variants suits their material and mesh.
+	bool load(const std::string& fileName, AssetLoader& loader, const ShaderVariants& variants);
+
+	//-1 if there is nothing with that name
+	int findMesh(const std::string& name) const;
+	int findTexture(const std::string& name) const;
+	int findMaterial(const std::string& name) const;
+
+	//Move every entity's world box to its current model matrix. Call after the transforms change.
+	void updateBounds();
+
+	//Add a draw for every entity inside the frustum whose mesh has finished loading, with the variant in the current mode
+	CullStats buildQueue(RenderQueue& queue, const Frustum& frustum);
+};
+
+//Translate, then rotate by angle degrees about axis, then scale
+glm::mat4 objectMatrix(glm::vec3 position, float angle, glm::vec3 axis, glm::vec3 scale);
+
+#endif // SCENE_H
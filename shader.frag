@@ -1,7 +1,22 @@
 #version 150
 
+//Compiled once per variant, see ShaderVariants in shadervariants.h:
+//  SHADING_MODE  0 regular, 1 light only, 2 ambient only, 3 texture and colour only
+//  TEXTURED      the surface has a texture
+//  VERTEX_COLOUR the mesh has vertex colours
+#ifndef SHADING_MODE
+#define SHADING_MODE 0
+#endif
+#if SHADING_MODE == 0 || SHADING_MODE == 1
+#define LIT
+#endif
+
+#ifdef VERTEX_COLOUR
 in vec3 Colour;
+#endif
+#ifdef TEXTURED
 in vec2 Texcoord;
+#endif
 
 //frag position and normals in view space
 in vec4 fragNormalView;
@@ -9,30 +24,77 @@ in vec4 fragPositionView;
 
 out vec4 outColor;
 
+#ifdef TEXTURED
 uniform sampler2D tex;
-const int lightNum = 2;
-uniform vec4 light_position[lightNum];
-uniform vec4 light_colour[lightNum];
-uniform int mode;
+#endif
+
+#ifdef LIT
+//Lights binned per cluster, see LightManager in lights.h
+uniform samplerBuffer lightData;      //View space position and radius, then colour, per light
+uniform usamplerBuffer clusterRanges; //First index and count per cluster
+uniform usamplerBuffer lightIndices;
+
+//Cluster grid size, matches lights.h
+const int clusterX = 16;
+const int clusterY = 9;
+const int clusterZ = 24;
+#endif
+
+//Set once per view, see PassUniforms in uniforms.h
+layout(std140) uniform PassBlock
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewProj;
+	vec4 cluster; //Tiles per pixel in x and y, then scale and bias from log depth to slice
+};
+
+//Texture and vertex colour, whichever this variant has
+vec4 surfaceColour()
+{
+	vec4 surface = vec4(1.0);
+#ifdef TEXTURED
+	surface *= texture(tex, Texcoord);
+#endif
+#ifdef VERTEX_COLOUR
+	surface *= vec4(Colour, 1.0);
+#endif
+	return surface;
+}
 
 void main()
 {	
 	vec4 diffuse  = vec4(0,0,0,1);
 	vec4 specular = vec4(0,0,0,1);
-	float d = 0;
-	for(int i = 0; i < lightNum; i++)
+
+#ifdef LIT
+
+	//Find which cluster this fragment is in
+	ivec3 tile = ivec3(gl_FragCoord.xy * cluster.xy, log(max(-fragPositionView.z, 1e-4)) * cluster.z + cluster.w);
+	tile = clamp(tile, ivec3(0), ivec3(clusterX - 1, clusterY - 1, clusterZ - 1));
+	uvec2 range = texelFetch(clusterRanges, (tile.z * clusterY + tile.y) * clusterX + tile.x).xy;
+
+	for(uint n = 0u; n < range.y; n++)
 	{
+		int i = int(texelFetch(lightIndices, int(range.x + n)).x);
+		vec4 light = texelFetch(lightData, i * 2);
+		vec4 light_colour = texelFetch(lightData, i * 2 + 1);
+
 		//Compute direction of light from frag position in view space
-		vec3 lightDisplacement = light_position[i].xyz - fragPositionView.xyz;
+		vec3 lightDisplacement = light.xyz - fragPositionView.xyz;
 	
 		//Distance to light
 		float d = length(lightDisplacement);
 	
+		//1/d^2, faded to nothing at the light's radius so clusters past it don't miss anything
+		float window = clamp(1 - pow(d / light.w, 4), 0, 1);
+		float falloff = window * window / (d*d);
+
 		//Normalised light vector
 		vec3 normalisedLightDisp = normalize(lightDisplacement);
 	
 		//Lambertian light equation for diffuse component
-		diffuse += dot(normalisedLightDisp, fragNormalView.xyz) * (1/(d*d)) * light_colour[i];
+		diffuse += dot(normalisedLightDisp, fragNormalView.xyz) * falloff * light_colour;
 	
 		//Compute light reflection using (negate normalisedLightDisp because the light comes from the light to the surface)
 		vec3 reflection = reflect(-normalisedLightDisp, fragNormalView.xyz);
@@ -40,28 +102,23 @@ void main()
 		//Specular component.
 		float shininess = 100;
 		float specular_intensity = clamp(dot(reflection, -normalize(fragPositionView.xyz)),0,1);
-		specular += pow(specular_intensity, shininess) * (1/(d*d)) * light_colour[i];
+		specular += pow(specular_intensity, shininess) * falloff * light_colour;
 	}
+#endif
 
 
 	//Ambient
 	vec4 ambient = vec4(0.1,0.1,0.1,0.01);
 
-	switch (mode)
-	{
-		case 0:
-			outColor =  ((diffuse + specular) + ambient) * texture(tex, Texcoord) * vec4(Colour, 1.0); //Regular
-			break;
-		case 1:
-			outColor =  (diffuse + specular)  + ambient; //Light only
-			break;
-		case 2:
-			outColor = ambient; //Distance from light
-			break;
-		case 3:
-			outColor = texture(tex,Texcoord) * vec4(Colour, 1.0); //Texture and colour only
-
-	}
+#if SHADING_MODE == 0
+	outColor =  ((diffuse + specular) + ambient) * surfaceColour(); //Regular
+#elif SHADING_MODE == 1
+	outColor =  (diffuse + specular)  + ambient; //Light only
+#elif SHADING_MODE == 2
+	outColor = ambient; //Distance from light
+#else
+	outColor = surfaceColour(); //Texture and colour only
+#endif
 
     //Final total colour including diffuse, specular, ambient, falloff (with 1/d^2), texture and colour
     //outColor =  ((diffuse + specular) * (1/(d*d)) + ambient) * texture(tex, Texcoord) * vec4(Colour, 1.0);
@@ -1,24 +1,41 @@
 #version 150
 
+//TEXTURED and VERTEX_COLOUR come from ShaderVariants, see shader.frag
+
 in vec3 position;
 in vec3 colour;
 in vec3 normal;
 in vec2 texcoord;
+in mat4 instanceModel; //Per instance, one column per attribute location
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
+//Set once per view, see PassUniforms in uniforms.h
+layout(std140) uniform PassBlock
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewProj;
+	vec4 cluster;
+};
 
+#ifdef VERTEX_COLOUR
 out vec3 Colour;
+#endif
+#ifdef TEXTURED
 out vec2 Texcoord;
+#endif
 out vec4 fragNormalView;
 out vec4 fragPositionView;
 
 void main()
 {
 	//Pass through the texture and colour
+#ifdef TEXTURED
 	Texcoord = texcoord;
+#endif
+#ifdef VERTEX_COLOUR
 	Colour = colour;
+#endif
+	mat4 model = instanceModel;
 	
 	//Send the view space normals for later
 	vec4 norm = view * model * vec4(normal, 0.0);
@@ -0,0 +1,39 @@
+#include "shadervariants.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+unsigned int meshVariantFlags(const Mesh& mesh)
+{
+	for (int i = 0; i < mesh.layout.attributeCount; i++)
+	{
+		if (mesh.layout.attributes[i].semantic == ATTRIB_COLOUR) return VARIANT_VERTEX_COLOUR;
+	}
+	return 0;
+}
+
+ShaderVariants::ShaderVariants(ProgramCache& programs, const char* vertexFile, const char* fragmentFile, const ProgramSetup& setup)
+{
+	this->programs = &programs;
+	mode = 0;
+	for (int m = 0; m < SHADING_MODE_COUNT; m++)
+	{
+		for (unsigned int flags = 0; flags < VARIANT_FLAG_COMBINATIONS; flags++)
+		{
+			//Light only and ambient only never look at the surface, so those share one program
+			unsigned int used = (m == 1 || m == 2) ? 0 : flags;
+			std::ostringstream shadingMode;
+			shadingMode << "SHADING_MODE " << m;
+			std::vector<std::string> defines(1, shadingMode.str());
+			if (used & VARIANT_TEXTURED) defines.push_back("TEXTURED");
+			if (used & VARIANT_VERTEX_COLOUR) defines.push_back("VERTEX_COLOUR");
+			variants[m][flags] = programs.requestFiles(vertexFile, fragmentFile, defines, setup);
+		}
+	}
+}
+
+GLuint ShaderVariants::get(int mode, unsigned int flags) const
+{
+	return programs->getProgram(variants[mode % SHADING_MODE_COUNT][flags % VARIANT_FLAG_COMBINATIONS]);
+}
@@ -0,0 +1,46 @@
+#ifndef SHADERVARIANTS_H
+#define SHADERVARIANTS_H
+
+#include <GL/glew.h>
+
+#include "mesh.h"
+#include "programcache.h"
+
+//Shading modes V cycles through, each compiled in as SHADING_MODE: regular, light only, ambient only,
+//texture and colour only
+const int SHADING_MODE_COUNT = 4;
+
+//What a surface has to draw with, each one a #define of the same name in the shaders
+enum shader_variant_flag_t
+{
+	VARIANT_TEXTURED = 1,      //Samples tex at Texcoord
+	VARIANT_VERTEX_COLOUR = 2, //Multiplies by the mesh's colour attribute
+	VARIANT_FLAG_COMBINATIONS = 4
+};
+
+//VARIANT_VERTEX_COLOUR if the mesh has colours, otherwise white would be multiplied in for nothing
+unsigned int meshVariantFlags(const Mesh& mesh);
+
+//One shader pair specialised into a program for every shading mode and flag combination, so the hot fragment
+//shader never branches on a mode and untextured surfaces never sample. All of them are requested from the
+//cache up front, to compile side by side, and are ready once the cache has been finished.
+class ShaderVariants
+{
+protected:
+	ProgramCache* programs;
+	int variants[SHADING_MODE_COUNT][VARIANT_FLAG_COMBINATIONS]; //Indices into programs
+	int mode;
+
+public:
+	//setup runs on each variant once it has linked
+	ShaderVariants(ProgramCache& programs, const char* vertexFile, const char* fragmentFile, const ProgramSetup& setup = ProgramSetup());
+
+	void setMode(int mode) { this->mode = mode; }
+	int getMode() const { return mode; }
+
+	//The program for a surface with these flags in the current mode
+	GLuint get(unsigned int flags) const { return get(mode, flags); }
+	GLuint get(int mode, unsigned int flags) const;
+};
+
+#endif // SHADERVARIANTS_H
@@ -0,0 +1,268 @@
+#include "shapecache.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionShapes/btShapeHull.h>
+
+#include "filemapping.h"
+
+//Enough digits that different floats never make the same key
+static std::string shapeKey(const char* type, const float* values, int count)
+{
+	std::ostringstream key;
+	key << type << std::setprecision(9);
+	for (int i = 0; i < count; i++) key << " " << values[i];
+	return key.str();
+}
+
+static bool writeShapeCache(const std::string& path, unsigned long long sourceHash, unsigned int importFlags, const std::vector<float>& vertices, const std::vector<int>& indices, const void* bvh, unsigned int bvhBytes)
+{
+	ShapeCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SHAPE_CACHE_MAGIC;
+	header.version = SHAPE_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.importFlags = importFlags;
+	header.pointerSize = sizeof(void*);
+	header.vertexCount = (unsigned int)(vertices.size() / 3);
+	header.indexCount = (unsigned int)indices.size();
+	header.bvhBytes = bvhBytes;
+	header.vertexOffset = sizeof(ShapeCacheHeader);
+	header.indexOffset = header.vertexOffset + vertices.size() * sizeof(float);
+	header.bvhOffset = (header.indexOffset + indices.size() * sizeof(int) + 15) & ~15ull;
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL) return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	if (ok && !vertices.empty()) ok = fwrite(&vertices[0], sizeof(float), vertices.size(), file) == vertices.size();
+	if (ok && !indices.empty()) ok = fwrite(&indices[0], sizeof(int), indices.size(), file) == indices.size();
+	unsigned char padding[16] = { 0 };
+	size_t paddingSize = (size_t)(header.bvhOffset - header.indexOffset - indices.size() * sizeof(int));
+	if (ok && bvhBytes && paddingSize) ok = fwrite(padding, 1, paddingSize, file) == paddingSize;
+	if (ok && bvhBytes) ok = fwrite(bvh, 1, bvhBytes, file) == bvhBytes;
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+	{
+		//Never leave a half written cache behind
+		remove(path.c_str());
+	}
+	return ok;
+}
+
+//Load a cache written from this exact source. A BVH blob, if there is one, is copied into a new 16 byte aligned
+//buffer the caller frees with btAlignedFree().
+static bool readShapeCache(const std::string& path, unsigned long long sourceHash, unsigned int importFlags, std::vector<float>& vertices, std::vector<int>& indices, void** bvh, unsigned int* bvhBytes)
+{
+	FileMapping mapping;
+	if (!mapping.open(path) || mapping.getLength() < sizeof(ShapeCacheHeader)) return false;
+
+	const ShapeCacheHeader* h = (const ShapeCacheHeader*)mapping.getData();
+	if (h->magic != SHAPE_CACHE_MAGIC || h->version != SHAPE_CACHE_VERSION) return false;
+	if (h->sourceHash != sourceHash || h->importFlags != importFlags || h->pointerSize != sizeof(void*)) return false;
+	if ((bvh != NULL) != (h->bvhBytes != 0)) return false;
+
+	//Make sure the blobs the header points at are actually in the file. Counts are checked against the room
+	//left after their offset, so a crafted header can't wrap the sums around.
+	unsigned long long length = mapping.getLength();
+	if (h->vertexOffset > h->indexOffset || h->indexOffset > length) return false;
+	if (h->vertexCount > (h->indexOffset - h->vertexOffset) / (3 * sizeof(float))) return false;
+	if (h->indexCount > (length - h->indexOffset) / sizeof(int)) return false;
+	if (h->bvhBytes && (h->bvhOffset > length || h->bvhBytes > length - h->bvhOffset)) return false;
+
+	const float* vertexData = (const float*)(mapping.getData() + h->vertexOffset);
+	vertices.assign(vertexData, vertexData + h->vertexCount * 3);
+	const int* indexData = (const int*)(mapping.getData() + h->indexOffset);
+	indices.assign(indexData, indexData + h->indexCount);
+	if (bvh != NULL)
+	{
+		*bvh = btAlignedAlloc(h->bvhBytes, 16);
+		memcpy(*bvh, mapping.getData() + h->bvhOffset, h->bvhBytes);
+		*bvhBytes = h->bvhBytes;
+	}
+	return true;
+}
+
+ShapeCache::~ShapeCache()
+{
+	//Wrappers before what they wrap
+	for (std::map<btCollisionShape*, Scaled>::iterator it = scaled.begin(); it != scaled.end(); ++it) delete it->first;
+	for (std::map<std::string, btCollisionShape*>::iterator it = shapes.begin(); it != shapes.end(); ++it)
+	{
+		if (scaled.find(it->second) == scaled.end()) delete it->second;
+	}
+	for (size_t i = 0; i < triangleData.size(); i++)
+	{
+		delete triangleData[i]->mesh;
+		if (triangleData[i]->bvhBuffer != NULL) btAlignedFree(triangleData[i]->bvhBuffer);
+		delete triangleData[i];
+	}
+}
+
+btCollisionShape* ShapeCache::getBox(const glm::vec3& halfExtents)
+{
+	std::string key = shapeKey("box", &halfExtents.x, 3);
+	btCollisionShape*& shape = shapes[key];
+	if (shape == NULL) shape = new btBoxShape(btVector3(halfExtents.x, halfExtents.y, halfExtents.z));
+	return shape;
+}
+
+btCollisionShape* ShapeCache::getSphere(float radius)
+{
+	std::string key = shapeKey("sphere", &radius, 1);
+	btCollisionShape*& shape = shapes[key];
+	if (shape == NULL) shape = new btSphereShape(radius);
+	return shape;
+}
+
+btCollisionShape* ShapeCache::getPlane(const glm::vec3& normal, float constant)
+{
+	float values[4] = { normal.x, normal.y, normal.z, constant };
+	std::string key = shapeKey("plane", values, 4);
+	btCollisionShape*& shape = shapes[key];
+	if (shape == NULL) shape = new btStaticPlaneShape(btVector3(normal.x, normal.y, normal.z), constant);
+	return shape;
+}
+
+btCollisionShape* ShapeCache::getHull(const std::string& meshFile)
+{
+	std::string key = "hull " + meshFile;
+	std::map<std::string, btCollisionShape*>::iterator found = shapes.find(key);
+	if (found != shapes.end()) return found->second;
+
+	std::string cacheName = meshFile + ".hullcache";
+	unsigned long long sourceHash = hashFile(meshFile);
+	std::vector<float> points;
+	std::vector<int> noIndices;
+	if (!readShapeCache(cacheName, sourceHash, importFlags, points, noIndices, NULL, NULL))
+	{
+		std::vector<float> vertices;
+		std::vector<int> indices;
+		if (!readMesh || !readMesh(meshFile, vertices, indices))
+		{
+			std::cout << "WARNING: couldn't make a hull for " << meshFile << std::endl;
+			return NULL;
+		}
+		//Every vertex of the mesh, cut down to a few dozen that still wrap it
+		btConvexHullShape full;
+		for (size_t i = 0; i < vertices.size(); i += 3) full.addPoint(btVector3(vertices[i], vertices[i + 1], vertices[i + 2]), false);
+		full.recalcLocalAabb();
+		btShapeHull simplified(&full);
+		simplified.buildHull(full.getMargin());
+		for (int i = 0; i < simplified.numVertices(); i++)
+		{
+			const btVector3& p = simplified.getVertexPointer()[i];
+			points.push_back(float(p.x()));
+			points.push_back(float(p.y()));
+			points.push_back(float(p.z()));
+		}
+		std::cout << meshFile << ": hull of " << vertices.size() / 3 << " vertices -> " << points.size() / 3 << " points" << std::endl;
+		writeShapeCache(cacheName, sourceHash, importFlags, points, noIndices, NULL, 0);
+	}
+
+	btConvexHullShape* hull = new btConvexHullShape();
+	for (size_t i = 0; i + 2 < points.size(); i += 3) hull->addPoint(btVector3(points[i], points[i + 1], points[i + 2]), false);
+	hull->recalcLocalAabb();
+	shapes[key] = hull;
+	return hull;
+}
+
+btCollisionShape* ShapeCache::getTriangleMesh(const std::string& meshFile)
+{
+	std::string key = "mesh " + meshFile;
+	std::map<std::string, btCollisionShape*>::iterator found = shapes.find(key);
+	if (found != shapes.end()) return found->second;
+
+	std::string cacheName = meshFile + ".bvhcache";
+	unsigned long long sourceHash = hashFile(meshFile);
+	TriangleData* data = new TriangleData();
+	data->mesh = NULL;
+	data->bvhBuffer = NULL;
+	unsigned int bvhBytes = 0;
+	bool fromCache = readShapeCache(cacheName, sourceHash, importFlags, data->vertices, data->indices, &data->bvhBuffer, &bvhBytes);
+	bool read = fromCache || (readMesh && readMesh(meshFile, data->vertices, data->indices));
+	if (!read || data->vertices.empty() || data->indices.empty())
+	{
+		//Bullet needs at least one triangle to point at
+		std::cout << "WARNING: couldn't make a triangle mesh for " << meshFile << std::endl;
+		if (data->bvhBuffer != NULL) btAlignedFree(data->bvhBuffer);
+		delete data;
+		return NULL;
+	}
+
+	//Bullet reads the triangles straight out of our arrays
+	btIndexedMesh part;
+	part.m_numTriangles = (int)(data->indices.size() / 3);
+	part.m_triangleIndexBase = (const unsigned char*)&data->indices[0];
+	part.m_triangleIndexStride = 3 * sizeof(int);
+	part.m_numVertices = (int)(data->vertices.size() / 3);
+	part.m_vertexBase = (const unsigned char*)&data->vertices[0];
+	part.m_vertexStride = 3 * sizeof(float);
+	part.m_vertexType = PHY_FLOAT;
+	data->mesh = new btTriangleIndexVertexArray();
+	data->mesh->addIndexedMesh(part, PHY_INTEGER);
+	triangleData.push_back(data);
+
+	btBvhTriangleMeshShape* shape;
+	if (fromCache)
+	{
+		//The saved tree is used where it sits, nothing is rebuilt
+		shape = new btBvhTriangleMeshShape(data->mesh, true, false);
+		shape->setOptimizedBvh(btOptimizedBvh::deSerializeInPlace(data->bvhBuffer, bvhBytes, false));
+	}
+	else
+	{
+		shape = new btBvhTriangleMeshShape(data->mesh, true);
+		btOptimizedBvh* bvh = shape->getOptimizedBvh();
+		bvhBytes = bvh->calculateSerializeBufferSize();
+		void* buffer = btAlignedAlloc(bvhBytes, 16);
+		if (bvh->serializeInPlace(buffer, bvhBytes, false)) writeShapeCache(cacheName, sourceHash, importFlags, data->vertices, data->indices, buffer, bvhBytes);
+		btAlignedFree(buffer);
+		std::cout << meshFile << ": BVH over " << data->indices.size() / 3 << " triangles" << std::endl;
+	}
+	shapes[key] = shape;
+	return shape;
+}
+
+btCollisionShape* ShapeCache::getScaled(btCollisionShape* shape, float scale)
+{
+	//Always wrap the original, never a wrapper
+	std::map<btCollisionShape*, Scaled>::const_iterator wrapped = scaled.find(shape);
+	if (wrapped != scaled.end()) shape = wrapped->second.base;
+	if (scale == 1) return shape;
+
+	std::ostringstream key;
+	key << "scaled " << (const void*)shape << " " << std::setprecision(9) << scale;
+	btCollisionShape*& result = shapes[key.str()];
+	if (result != NULL) return result;
+
+	if (shape->isConvex())
+	{
+		result = new btUniformScalingShape((btConvexShape*)shape, scale);
+	}
+	else if (shape->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE)
+	{
+		result = new btScaledBvhTriangleMeshShape((btBvhTriangleMeshShape*)shape, btVector3(scale, scale, scale));
+	}
+	else
+	{
+		//Planes go on forever anyway
+		shapes.erase(key.str());
+		return shape;
+	}
+	Scaled record = { shape, scale };
+	scaled[result] = record;
+	return result;
+}
+
+float ShapeCache::getScale(btCollisionShape* shape) const
+{
+	std::map<btCollisionShape*, Scaled>::const_iterator wrapped = scaled.find(shape);
+	return wrapped == scaled.end() ? 1.0f : wrapped->second.scale;
+}
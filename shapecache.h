@@ -0,0 +1,101 @@
+#ifndef SHAPECACHE_H
+#define SHAPECACHE_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+class btCollisionShape;
+class btTriangleIndexVertexArray;
+
+//Hulls and BVHs built from a mesh are written next to it as <mesh>.hullcache / <mesh>.bvhcache.
+//
+//File layout, native endian:
+//  ShapeCacheHeader
+//  vertex blob at vertexOffset  (vertexCount * 3 floats)
+//  index blob at indexOffset    (indexCount ints, BVH caches only)
+//  BVH blob at bvhOffset        (btOptimizedBvh::serializeInPlace() output, 16 byte aligned, BVH caches only)
+
+const unsigned int SHAPE_CACHE_MAGIC = 0x50485348; // "HSHP"
+const unsigned int SHAPE_CACHE_VERSION = 1;        //Bump whenever the hull or BVH building changes
+
+struct ShapeCacheHeader
+{
+	unsigned long long sourceHash; //hashFile() of the source mesh
+	unsigned long long vertexOffset;
+	unsigned long long indexOffset;
+	unsigned long long bvhOffset;
+	unsigned int magic;
+	unsigned int version;
+	unsigned int importFlags;      //What the MeshReader that made it said its import flags were
+	unsigned int pointerSize;      //The BVH blob is only good for the same build
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int bvhBytes;
+	unsigned int reserved;
+};
+
+//Fills in a mesh file's welded vertices (3 floats each) and triangle indices, false if it couldn't be read.
+//The renderer's is importMesh() from assetloader, which the cache doesn't link against so it builds without GL.
+typedef std::function<bool(const std::string& meshFile, std::vector<float>& vertices, std::vector<int>& indices)> MeshReader;
+
+//Every collision shape in the world, made once per distinct type and size and shared between the bodies that use it.
+//Per body scale is done by wrapping a shared shape rather than scaling it, so scaling one body leaves the rest alone.
+//Shapes are owned by the cache and live until it is destroyed, after every body using them.
+class ShapeCache
+{
+protected:
+	//Triangles a BVH shape points into, kept alive alongside it
+	struct TriangleData
+	{
+		std::vector<float> vertices;
+		std::vector<int> indices;
+		btTriangleIndexVertexArray* mesh;
+		void* bvhBuffer; //Where a BVH loaded from disk lives, NULL if the shape built its own
+	};
+
+	//Where a wrapped shape came from
+	struct Scaled
+	{
+		btCollisionShape* base;
+		float scale;
+	};
+
+	std::map<std::string, btCollisionShape*> shapes; //By type and dimensions, or mesh file
+	std::map<btCollisionShape*, Scaled> scaled;
+	std::vector<TriangleData*> triangleData;
+
+	MeshReader readMesh;
+	unsigned int importFlags;
+
+	//Owns every shape, so not copyable
+	ShapeCache(const ShapeCache&);
+	ShapeCache& operator=(const ShapeCache&);
+
+public:
+	//Hulls and BVHs are made from what readMesh gives back, and their caches are only used if they were written with
+	//the same importFlags. Without a reader only meshes that already have a cache get a shape.
+	ShapeCache(const MeshReader& readMesh = MeshReader(), unsigned int importFlags = 0) : readMesh(readMesh), importFlags(importFlags) {}
+	~ShapeCache();
+
+	btCollisionShape* getBox(const glm::vec3& halfExtents);
+	btCollisionShape* getSphere(float radius);
+	btCollisionShape* getPlane(const glm::vec3& normal, float constant);
+
+	//Simplified convex hull around a mesh file's vertices, for dynamic bodies. NULL if the mesh couldn't be read.
+	btCollisionShape* getHull(const std::string& meshFile);
+	//The mesh's own triangles in a BVH, for static bodies only. NULL if the mesh couldn't be read.
+	btCollisionShape* getTriangleMesh(const std::string& meshFile);
+
+	//shape at a uniform scale, shared between everything at that scale. Scale 1, and shapes that
+	//can't be scaled like planes, give back the unscaled shape. shape can itself be a scaled one.
+	btCollisionShape* getScaled(btCollisionShape* shape, float scale);
+	float getScale(btCollisionShape* shape) const;
+
+	size_t size() const { return shapes.size(); }
+};
+
+#endif // SHAPECACHE_H
@@ -0,0 +1,168 @@
+#include "taskscheduler.h"
+
+#if BT_THREADSAFE
+
+//Set while a thread is inside a loop, so a loop started from within one runs in place rather than deadlocking
+static thread_local bool insideLoop = false;
+
+WorkStealingScheduler::WorkStealingScheduler(int threadCount) : btITaskScheduler("WorkStealing")
+{
+	forBody = NULL;
+	sumBody = NULL;
+	sum = 0;
+	remaining = 0;
+	generation = 0;
+	stopping = false;
+	this->threadCount = 1;
+	queues.push_back(new Queue());
+	setNumThreads(threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency());
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+	for (size_t i = 0; i < queues.size(); i++) delete queues[i];
+}
+
+int WorkStealingScheduler::getMaxNumThreads() const
+{
+	return BT_MAX_THREAD_COUNT - 1; //Bullet numbers threads from 0, with room kept for whoever steps the world
+}
+
+//Threads are made as the count grows but never destroyed before the scheduler is, because Bullet hands out
+//per thread slots that are never given back. Threads past the count just stay asleep.
+void WorkStealingScheduler::setNumThreads(int count)
+{
+	if (count < 1) count = 1;
+	if (count > getMaxNumThreads()) count = getMaxNumThreads();
+	while ((int)queues.size() < count)
+	{
+		queues.push_back(new Queue());
+		workers.push_back(std::thread(&WorkStealingScheduler::workerLoop, this, (int)queues.size() - 1));
+	}
+	std::lock_guard<std::mutex> lock(wakeMutex);
+	threadCount = count;
+}
+
+void WorkStealingScheduler::workerLoop(int index)
+{
+	unsigned int seen = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wakeUp.wait(lock, [this, &seen] { return stopping || generation != seen; });
+			if (stopping) return;
+			seen = generation;
+			if (index >= threadCount) continue;
+		}
+		insideLoop = true;
+		while (runOne(index)) {}
+		insideLoop = false;
+	}
+}
+
+bool WorkStealingScheduler::runOne(int index)
+{
+	Range range;
+	bool found = false;
+	{
+		Queue& own = *queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.ranges.empty())
+		{
+			range = own.ranges.front();
+			own.ranges.pop_front();
+			found = true;
+		}
+	}
+	//Steal from the far end of someone else's queue, away from where its owner is working
+	for (int i = 1; !found && i < threadCount; i++)
+	{
+		Queue& victim = *queues[(index + i) % threadCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.ranges.empty())
+		{
+			range = victim.ranges.back();
+			victim.ranges.pop_back();
+			found = true;
+		}
+	}
+	if (!found) return false;
+
+	if (sumBody != NULL)
+	{
+		btScalar part = sumBody->sumLoop(range.begin, range.end);
+		std::lock_guard<std::mutex> lock(sumMutex);
+		sum += part;
+	}
+	else
+	{
+		forBody->forLoop(range.begin, range.end);
+	}
+	remaining--;
+	return true;
+}
+
+void WorkStealingScheduler::runLoop(int begin, int end, int grainSize)
+{
+	if (grainSize < 1) grainSize = 1;
+	//Not worth waking anyone for
+	if (threadCount == 1 || end - begin <= grainSize)
+	{
+		if (sumBody != NULL) sum += sumBody->sumLoop(begin, end);
+		else forBody->forLoop(begin, end);
+		return;
+	}
+
+	remaining = (end - begin + grainSize - 1) / grainSize;
+	int chunk = 0;
+	for (int first = begin; first < end; first += grainSize, chunk++)
+	{
+		Range range = { first, first + grainSize < end ? first + grainSize : end };
+		Queue& queue = *queues[chunk % threadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.ranges.push_back(range);
+	}
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		generation++;
+	}
+	wakeUp.notify_all();
+
+	insideLoop = true;
+	while (runOne(0)) {}
+	insideLoop = false;
+	//Everything has been taken, wait for whatever the workers are still in the middle of
+	while (remaining > 0) std::this_thread::yield();
+}
+
+void WorkStealingScheduler::parallelFor(int begin, int end, int grainSize, const btIParallelForBody& body)
+{
+	if (insideLoop)
+	{
+		body.forLoop(begin, end);
+		return;
+	}
+	forBody = &body;
+	sumBody = NULL;
+	runLoop(begin, end, grainSize);
+}
+
+btScalar WorkStealingScheduler::parallelSum(int begin, int end, int grainSize, const btIParallelSumBody& body)
+{
+	if (insideLoop) return body.sumLoop(begin, end);
+	forBody = NULL;
+	sumBody = &body;
+	sum = 0;
+	runLoop(begin, end, grainSize);
+	sumBody = NULL;
+	return sum;
+}
+
+#endif // BT_THREADSAFE
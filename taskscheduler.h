@@ -0,0 +1,72 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include <LinearMath/btThreads.h>
+
+//Bullet's multithreaded world only exists when Bullet is built with BT_THREADSAFE
+#if BT_THREADSAFE
+
+//Runs Bullet's parallel loops on our own threads rather than OpenMP or TBB.
+//Each loop is cut into grain sized ranges dealt out round robin to per thread queues. Threads work from the
+//front of their own queue and steal from the back of the others' once it's empty, so uneven ranges even out.
+//The thread that calls parallelFor() works through its own queue alongside the pool.
+class WorkStealingScheduler : public btITaskScheduler
+{
+protected:
+	struct Range
+	{
+		int begin, end;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Range> ranges;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<Queue*> queues;   //0 is the calling thread's, then one per worker
+	std::atomic<int> threadCount; //Including the calling thread
+
+	//The loop being run
+	const btIParallelForBody* forBody;
+	const btIParallelSumBody* sumBody;
+	btScalar sum;
+	std::mutex sumMutex;
+	std::atomic<int> remaining; //Ranges not yet finished
+
+	//Waking the workers for a new loop
+	std::mutex wakeMutex;
+	std::condition_variable wakeUp;
+	unsigned int generation; //Bumped for every loop
+	bool stopping;
+
+	void startWorkers(int count);
+	void stopWorkers();
+	void workerLoop(int index);
+	bool runOne(int index); //False once there is nothing left to take, even by stealing
+	void runLoop(int begin, int end, int grainSize);
+
+public:
+	//0 threads means one per core
+	WorkStealingScheduler(int threadCount = 0);
+	~WorkStealingScheduler();
+
+	int getMaxNumThreads() const;
+	int getNumThreads() const { return threadCount; }
+	void setNumThreads(int count);
+	void parallelFor(int begin, int end, int grainSize, const btIParallelForBody& body);
+	btScalar parallelSum(int begin, int end, int grainSize, const btIParallelSumBody& body);
+};
+
+#endif // BT_THREADSAFE
+
+#endif // TASKSCHEDULER_H
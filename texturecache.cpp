@@ -0,0 +1,361 @@
+#include "texturecache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Library for loading textures (Simple OpenGL Image Library)
+#include <SOIL.h>
+
+//Half the size, each texel the average of the 2x2 it covers. Odd edges reuse their last row or column.
+static void halveImage(const std::vector<unsigned char>& source, int width, int height, std::vector<unsigned char>& result)
+{
+	int halfWidth = width > 1 ? width / 2 : 1;
+	int halfHeight = height > 1 ? height / 2 : 1;
+	result.resize((size_t)halfWidth * halfHeight * 4);
+	for (int y = 0; y < halfHeight; y++)
+	{
+		int y0 = y * 2, y1 = (y * 2 + 1 < height) ? y * 2 + 1 : y * 2;
+		for (int x = 0; x < halfWidth; x++)
+		{
+			int x0 = x * 2, x1 = (x * 2 + 1 < width) ? x * 2 + 1 : x * 2;
+			for (int c = 0; c < 4; c++)
+			{
+				int sum = source[((size_t)y0 * width + x0) * 4 + c] + source[((size_t)y0 * width + x1) * 4 + c]
+					+ source[((size_t)y1 * width + x0) * 4 + c] + source[((size_t)y1 * width + x1) * 4 + c];
+				result[((size_t)y * halfWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+//The 4x4 texels at block (bx, by), clamped at the edges of images that aren't a multiple of 4
+static void fetchBlock(const std::vector<unsigned char>& image, int width, int height, int bx, int by, unsigned char block[16][4])
+{
+	for (int y = 0; y < 4; y++)
+	{
+		int sy = (by * 4 + y < height) ? by * 4 + y : height - 1;
+		for (int x = 0; x < 4; x++)
+		{
+			int sx = (bx * 4 + x < width) ? bx * 4 + x : width - 1;
+			memcpy(block[y * 4 + x], &image[((size_t)sy * width + sx) * 4], 4);
+		}
+	}
+}
+
+static unsigned short to565(const float colour[3])
+{
+	int r = (int)(colour[0] * 31 / 255 + 0.5f), g = (int)(colour[1] * 63 / 255 + 0.5f), b = (int)(colour[2] * 31 / 255 + 0.5f);
+	r = r < 0 ? 0 : (r > 31 ? 31 : r);
+	g = g < 0 ? 0 : (g > 63 ? 63 : g);
+	b = b < 0 ? 0 : (b > 31 ? 31 : b);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void from565(unsigned short packed, int colour[3])
+{
+	int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+	colour[0] = (r << 3) | (r >> 2);
+	colour[1] = (g << 2) | (g >> 4);
+	colour[2] = (b << 3) | (b >> 2);
+}
+
+//BC1 colour block: endpoints at the ends of the texels' principal axis, every texel snapped to the nearest of the
+//four colours between them
+static void encodeColourBlock(const unsigned char block[16][4], unsigned char out[8])
+{
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++) mean[c] += block[i][c] / 16.0f;
+	}
+	float cov[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+	for (int i = 0; i < 16; i++)
+	{
+		float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+		for (int a = 0; a < 3; a++)
+		{
+			for (int b = 0; b < 3; b++) cov[a][b] += d[a] * d[b];
+		}
+	}
+
+	//A few rounds of power iteration are plenty for a 3x3
+	float axis[3] = { 1, 1, 1 };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[3];
+		for (int a = 0; a < 3; a++) next[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+		float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (length < 1e-6f) break; //Flat colour, any axis will do
+		for (int a = 0; a < 3; a++) axis[a] = next[a] / length;
+	}
+
+	float lowest = 0, highest = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+		lowest = t < lowest ? t : lowest;
+		highest = t > highest ? t : highest;
+	}
+	float high[3], low[3];
+	for (int c = 0; c < 3; c++)
+	{
+		high[c] = mean[c] + axis[c] * highest;
+		low[c] = mean[c] + axis[c] * lowest;
+	}
+	unsigned short c0 = to565(high), c1 = to565(low);
+	if (c0 < c1)
+	{
+		unsigned short swap = c0;
+		c0 = c1;
+		c1 = swap;
+	}
+
+	//c0 > c1 picks the four colour mode, equal endpoints just use index 0
+	unsigned int indices = 0;
+	if (c0 != c1)
+	{
+		int palette[4][3];
+		from565(c0, palette[0]);
+		from565(c1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestDistance = 1 << 30;
+			for (int p = 0; p < 4; p++)
+			{
+				int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+				int distance = dr * dr + dg * dg + db * db;
+				if (distance < bestDistance)
+				{
+					best = p;
+					bestDistance = distance;
+				}
+			}
+			indices |= (unsigned int)best << (i * 2);
+		}
+	}
+	out[0] = (unsigned char)(c0 & 0xFF);
+	out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)(c1 & 0xFF);
+	out[3] = (unsigned char)(c1 >> 8);
+	for (int b = 0; b < 4; b++) out[4 + b] = (unsigned char)(indices >> (b * 8));
+}
+
+//BC3 alpha block: the range of the block's alpha in eight steps, three bits per texel
+static void encodeAlphaBlock(const unsigned char block[16][4], unsigned char out[8])
+{
+	int a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		a0 = block[i][3] > a0 ? block[i][3] : a0;
+		a1 = block[i][3] < a1 ? block[i][3] : a1;
+	}
+	unsigned long long indices = 0;
+	if (a0 != a1)
+	{
+		//a0 > a1 picks the eight step mode
+		int palette[8] = { a0, a1 };
+		for (int p = 1; p < 7; p++) palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestDistance = 256;
+			for (int p = 0; p < 8; p++)
+			{
+				int distance = abs(block[i][3] - palette[p]);
+				if (distance < bestDistance)
+				{
+					best = p;
+					bestDistance = distance;
+				}
+			}
+			indices |= (unsigned long long)best << (i * 3);
+		}
+	}
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for (int b = 0; b < 6; b++) out[2 + b] = (unsigned char)(indices >> (b * 8));
+}
+
+static void compressLevel(const std::vector<unsigned char>& image, int width, int height, bool alpha, std::vector<unsigned char>& result)
+{
+	int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	int blockBytes = alpha ? 16 : 8;
+	result.resize((size_t)blocksWide * blocksHigh * blockBytes);
+	unsigned char* out = result.empty() ? NULL : &result[0];
+	unsigned char block[16][4];
+	for (int by = 0; by < blocksHigh; by++)
+	{
+		for (int bx = 0; bx < blocksWide; bx++)
+		{
+			fetchBlock(image, width, height, bx, by, block);
+			if (alpha)
+			{
+				encodeAlphaBlock(block, out);
+				out += 8;
+			}
+			encodeColourBlock(block, out);
+			out += 8;
+		}
+	}
+}
+
+bool importTexture(const std::string& file, unsigned int formatFlags, TextureData& texture)
+{
+	int width, height, channels;
+	unsigned char* image = SOIL_load_image(file.c_str(), &width, &height, &channels, SOIL_LOAD_RGBA);
+	if (image == NULL || width <= 0 || height <= 0) return false;
+
+	std::vector<unsigned char> level(image, image + (size_t)width * height * 4);
+	SOIL_free_image_data(image);
+
+	bool alpha = false;
+	for (size_t i = 3; i < level.size() && !alpha; i += 4) alpha = level[i] != 255;
+	bool compress = (formatFlags & TEXTURE_COMPRESS) != 0;
+	texture.internalFormat = !compress ? GL_RGBA8 : (alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+	texture.width = width;
+	texture.height = height;
+	texture.levels.clear();
+
+	//Every level down to 1x1
+	int levelWidth = width, levelHeight = height;
+	while (true)
+	{
+		texture.levels.push_back(std::vector<unsigned char>());
+		if (compress) compressLevel(level, levelWidth, levelHeight, alpha, texture.levels.back());
+		else texture.levels.back() = level;
+		if ((levelWidth == 1 && levelHeight == 1) || texture.levels.size() == (size_t)TEXTURE_MAX_LEVELS) break;
+
+		std::vector<unsigned char> next;
+		halveImage(level, levelWidth, levelHeight, next);
+		level.swap(next);
+		levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+		levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+	}
+	return true;
+}
+
+bool writeTextureCache(const std::string& path, const TextureData& texture, unsigned long long sourceHash, unsigned int formatFlags)
+{
+	TextureCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = TEXTURE_CACHE_MAGIC;
+	header.version = TEXTURE_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.formatFlags = formatFlags;
+	header.internalFormat = texture.internalFormat;
+	header.width = texture.width;
+	header.height = texture.height;
+	header.levels = (unsigned int)texture.levels.size();
+	//Levels are small multiples of 8 bytes or 4 byte texels, so they stay aligned end to end
+	unsigned long long offset = sizeof(TextureCacheHeader);
+	for (size_t i = 0; i < texture.levels.size(); i++)
+	{
+		header.levelOffset[i] = offset;
+		header.levelBytes[i] = (unsigned int)texture.levels[i].size();
+		offset += texture.levels[i].size();
+	}
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL) return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (size_t i = 0; i < texture.levels.size() && ok; i++)
+	{
+		if (!texture.levels[i].empty()) ok = fwrite(&texture.levels[i][0], 1, texture.levels[i].size(), file) == texture.levels[i].size();
+	}
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+	{
+		//Never leave a half written cache behind
+		remove(path.c_str());
+	}
+	return ok;
+}
+
+//Whether bytes is exactly what a width x height level takes in one of the formats importTexture() makes
+static bool levelSizeMatches(unsigned int internalFormat, unsigned int width, unsigned int height, unsigned int bytes)
+{
+	unsigned long long units, unitBytes; //Texels or 4x4 blocks
+	if (internalFormat == GL_RGBA8)
+	{
+		units = (unsigned long long)width * height;
+		unitBytes = 4;
+	}
+	else if (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+	{
+		units = ((width + 3ULL) / 4) * ((height + 3ULL) / 4);
+		unitBytes = (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? 8 : 16;
+	}
+	else return false;
+	return bytes % unitBytes == 0 && bytes / unitBytes == units;
+}
+
+TextureCacheFile::TextureCacheFile()
+{
+	header = NULL;
+}
+
+bool TextureCacheFile::open(const std::string& path, unsigned long long sourceHash, unsigned int formatFlags)
+{
+	header = NULL;
+	if (!mapping.open(path)) return false;
+	if (mapping.getLength() < sizeof(TextureCacheHeader)) return false;
+
+	const TextureCacheHeader* h = (const TextureCacheHeader*)mapping.getData();
+	if (h->magic != TEXTURE_CACHE_MAGIC || h->version != TEXTURE_CACHE_VERSION) return false;
+	if (h->sourceHash != sourceHash || h->formatFlags != formatFlags) return false;
+	if (h->levels == 0 || h->levels > (unsigned int)TEXTURE_MAX_LEVELS || h->width == 0 || h->height == 0) return false;
+
+	//No more levels than the chain down to 1x1 has, or the upload asks for mips the storage doesn't have
+	unsigned int chain = 1;
+	for (unsigned int size = (h->width > h->height) ? h->width : h->height; size > 1; size /= 2) chain++;
+	if (h->levels > chain) return false;
+
+	//Make sure the blobs the header points at are actually in the file, and are the size their level needs
+	for (unsigned int i = 0; i < h->levels; i++)
+	{
+		if (h->levelOffset[i] > mapping.getLength() || h->levelBytes[i] > mapping.getLength() - h->levelOffset[i]) return false;
+		unsigned int levelWidth = (h->width >> i) > 0 ? (h->width >> i) : 1;
+		unsigned int levelHeight = (h->height >> i) > 0 ? (h->height >> i) : 1;
+		if (!levelSizeMatches(h->internalFormat, levelWidth, levelHeight, h->levelBytes[i])) return false;
+	}
+
+	header = h;
+	return true;
+}
+
+GLuint uploadTexture(GLenum internalFormat, int width, int height, int levels, const void* const* levelData, const size_t* levelBytes)
+{
+	bool compressed = internalFormat != GL_RGBA8;
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	//Immutable storage lets the driver lay the whole chain out once and skip completeness checks on every draw
+	bool immutable = GLEW_ARB_texture_storage != 0;
+	if (immutable) glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+	for (int i = 0; i < levels; i++)
+	{
+		int w = (width >> i) > 0 ? (width >> i) : 1;
+		int h = (height >> i) > 0 ? (height >> i) : 1;
+		if (immutable && compressed) glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, w, h, internalFormat, (GLsizei)levelBytes[i], levelData[i]);
+		else if (immutable) glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, levelData[i]);
+		else if (compressed) glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, w, h, 0, (GLsizei)levelBytes[i], levelData[i]);
+		else glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, levelData[i]);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	//Set sampler parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return texture;
+}
@@ -0,0 +1,79 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "filemapping.h"
+
+//Binary texture cache, written the first time an image is imported and memory mapped on later runs.
+//Holds the whole mip chain, already in the format it is uploaded in.
+//
+//File layout, all little endian:
+//  TextureCacheHeader
+//  level blobs at levelOffset[i]  (levelBytes[i] bytes each, level 0 first, rows in the order they're uploaded)
+
+const unsigned int TEXTURE_CACHE_MAGIC = 0x58455450; // "PTEX"
+const unsigned int TEXTURE_CACHE_VERSION = 1;        //Bump whenever importTexture() output changes
+const int TEXTURE_MAX_LEVELS = 16;
+
+//What importTexture() may compress to
+enum texture_format_t
+{
+	TEXTURE_COMPRESS = 1 //BC1 for opaque images and BC3 for ones with alpha, otherwise plain RGBA8
+};
+
+struct TextureCacheHeader
+{
+	unsigned long long sourceHash; //hashFile() of the source image
+	unsigned long long levelOffset[TEXTURE_MAX_LEVELS];
+	unsigned int levelBytes[TEXTURE_MAX_LEVELS];
+	unsigned int magic;
+	unsigned int version;
+	unsigned int formatFlags;      //texture_format_t flags it was imported with
+	unsigned int internalFormat;   //GL internal format of every level
+	unsigned int width;
+	unsigned int height;
+	unsigned int levels;
+	unsigned int reserved;
+};
+
+//A decoded image's mip chain, ready to upload
+struct TextureData
+{
+	GLenum internalFormat;
+	int width, height;
+	std::vector<std::vector<unsigned char> > levels;
+};
+
+//Decode an image, build its mips with a box filter and compress them. Thread safe. False if the image can't be read.
+bool importTexture(const std::string& file, unsigned int formatFlags, TextureData& texture);
+
+//Write a texture out in the cache format, false if the file couldn't be written
+bool writeTextureCache(const std::string& path, const TextureData& texture, unsigned long long sourceHash, unsigned int formatFlags);
+
+//A mapped cache file whose levels can be handed straight to glCompressedTexSubImage2D
+class TextureCacheFile
+{
+protected:
+	FileMapping mapping;
+	const TextureCacheHeader* header;
+
+public:
+	TextureCacheFile();
+
+	//Map the file and check it matches the source hash, format flags and file format version
+	bool open(const std::string& path, unsigned long long sourceHash, unsigned int formatFlags);
+
+	const TextureCacheHeader& getHeader() const { return *header; }
+	const void* getLevelData(int level) const { return mapping.getData() + header->levelOffset[level]; }
+	size_t getLevelBytes(int level) const { return header->levelBytes[level]; }
+};
+
+//Create an immutable texture with every level of the chain. levelData and levelBytes have one entry per level.
+//levelData may be offsets into the bound pixel unpack buffer.
+GLuint uploadTexture(GLenum internalFormat, int width, int height, int levels, const void* const* levelData, const size_t* levelBytes);
+
+#endif // TEXTURECACHE_H
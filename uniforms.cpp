@@ -0,0 +1,52 @@
+#include "uniforms.h"
+
+void bindUniformBlocks(GLuint program)
+{
+	GLuint pass = glGetUniformBlockIndex(program, "PassBlock");
+	if (pass != GL_INVALID_INDEX) glUniformBlockBinding(program, pass, BINDING_PASS);
+}
+
+UniformBuffers::UniformBuffers(int maxPasses)
+{
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment < 1) alignment = 1;
+	passStride = ((GLint)sizeof(PassUniforms) + alignment - 1) / alignment * alignment;
+	passCapacity = maxPasses > 0 ? maxPasses : 1;
+	passCount = 0;
+
+	glGenBuffers(1, &passBuffer);
+	orphanPasses();
+}
+
+UniformBuffers::~UniformBuffers()
+{
+	glDeleteBuffers(1, &passBuffer);
+}
+
+//New storage for the pass slices, the driver keeps the old one alive for whatever still reads it
+void UniformBuffers::orphanPasses()
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, passBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)passStride * passCapacity, NULL, GL_STREAM_DRAW);
+	passCount = 0;
+}
+
+void UniformBuffers::beginFrame()
+{
+	orphanPasses();
+}
+
+void UniformBuffers::setPass(const glm::mat4& view, const glm::mat4& proj, const glm::vec4& cluster)
+{
+	if (passCount == passCapacity) orphanPasses();
+	PassUniforms pass;
+	pass.view = view;
+	pass.proj = proj;
+	pass.viewProj = proj * view;
+	pass.cluster = cluster;
+	GLintptr offset = (GLintptr)passStride * passCount++;
+	glBindBuffer(GL_UNIFORM_BUFFER, passBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(PassUniforms), &pass);
+	glBindBufferRange(GL_UNIFORM_BUFFER, BINDING_PASS, passBuffer, offset, sizeof(PassUniforms));
+}
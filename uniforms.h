@@ -0,0 +1,52 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+
+//Binding points the blocks live at, set on each program by bindUniformBlocks()
+enum uniform_binding_t { BINDING_PASS };
+
+//std140 copy of the block in shader.vert and shader.frag, member for member.
+//Once per view drawn: the camera, each portal's view, each stencil portal level
+struct PassUniforms
+{
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::mat4 viewProj;
+	glm::vec4 cluster; //From LightManager::cluster(), zero for passes that don't light anything
+};
+
+//Point a freshly linked program's PassBlock at its binding point. Programs without one are left alone.
+void bindUniformBlocks(GLuint program);
+
+//The buffers behind the blocks. Each pass gets its own slice of one buffer, so setting up a pass is a
+//write and a glBindBufferRange() and never waits on draws from an earlier pass that are still in flight.
+class UniformBuffers
+{
+protected:
+	GLuint passBuffer;
+	GLint passStride;  //sizeof(PassUniforms) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	int passCapacity;  //Slices in passBuffer
+	int passCount;     //Slices used since the buffer was last orphaned
+
+	void orphanPasses();
+
+	//Owns GL buffers, so not copyable
+	UniformBuffers(const UniformBuffers&);
+	UniformBuffers& operator=(const UniformBuffers&);
+
+public:
+	//Going past maxPasses in a frame works, but costs a fresh buffer
+	UniformBuffers(int maxPasses = 64);
+	~UniformBuffers();
+
+	//Start handing out pass slices from the top of fresh storage
+	void beginFrame();
+
+	//Upload a pass's block and bind it for the draws that follow
+	void setPass(const glm::mat4& view, const glm::mat4& proj, const glm::vec4& cluster = glm::vec4(0));
+};
+
+#endif // UNIFORMS_H
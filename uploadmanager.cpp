@@ -0,0 +1,223 @@
+#include "uploadmanager.h"
+
+#include <chrono>
+#include <iostream>
+
+//Every allocation starts on this boundary, more than any pixel or index format needs
+const size_t STAGING_ALIGNMENT = 256;
+
+void StagingBlock::copyToBuffer(GLenum target, size_t dstOffset, size_t srcOffset, size_t count) const
+{
+	if (count == 0) return;
+	//The ring is bound to GL_COPY_READ_BUFFER while uploads are issued
+	if (allocation) glCopyBufferSubData(GL_COPY_READ_BUFFER, target, offset + srcOffset, dstOffset, count);
+	else glBufferSubData(target, dstOffset, count, &owned[srcOffset]);
+}
+
+const void* StagingBlock::getPixels(size_t srcOffset) const
+{
+	if (allocation) return (const void*)(offset + srcOffset);
+	return owned.empty() ? NULL : &owned[srcOffset];
+}
+
+UploadManager::UploadManager(size_t ringSize)
+{
+	ring = 0;
+	mapped = NULL;
+	this->ringSize = 0;
+	head = 0;
+	used = 0;
+	serial = 0;
+	completedSerial = 0;
+	stopping = false;
+	byteBudget = 4 << 20;
+	timeBudget = 2;
+	stats.bytes = 0;
+	stats.uploads = 0;
+	stats.queued = 0;
+	stats.waits = 0;
+	stats.ringUsed = 0;
+	stats.ringSize = 0;
+
+	//Persistent mapping lets workers write straight into memory the GPU copies from
+	if (ringSize > 0 && GLEW_ARB_buffer_storage && GLEW_ARB_sync)
+	{
+		ringSize = (ringSize + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &ring);
+		glBindBuffer(GL_COPY_READ_BUFFER, ring);
+		glBufferStorage(GL_COPY_READ_BUFFER, ringSize, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, ringSize, flags);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		if (mapped) this->ringSize = ringSize;
+		else
+		{
+			std::cout << "WARNING: Couldn't map the upload ring, staging in client memory" << std::endl;
+			glDeleteBuffers(1, &ring);
+			ring = 0;
+		}
+	}
+	stats.ringSize = this->ringSize;
+}
+
+UploadManager::~UploadManager()
+{
+	shutdown();
+	for (size_t i = 0; i < fences.size(); i++) glDeleteSync(fences[i].first);
+	if (ring)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, ring);
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &ring);
+	}
+}
+
+bool UploadManager::allocateRing(size_t bytes, size_t& offset, size_t& consumed)
+{
+	if (used == 0) head = 0;
+	size_t tail = (head + ringSize - used) % ringSize;
+	if (used < ringSize && head >= tail)
+	{
+		//Free space runs from head to the end, then from the start up to tail
+		if (ringSize - head >= bytes) { offset = head; consumed = bytes; }
+		else if (tail >= bytes) { offset = 0; consumed = ringSize - head + bytes; }
+		else return false;
+	}
+	else
+	{
+		if (tail - head < bytes) return false;
+		offset = head;
+		consumed = bytes;
+	}
+	head = (offset + bytes) % ringSize;
+	used += consumed;
+	return true;
+}
+
+StagingHandle UploadManager::allocate(size_t bytes)
+{
+	StagingHandle block = std::make_shared<StagingBlock>();
+	block->bytes = bytes;
+	size_t rounded = (bytes + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+	if (ringSize > 0 && rounded > 0 && rounded <= ringSize)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		size_t offset, consumed;
+		bool waited = false;
+		while (!stopping && !allocateRing(rounded, offset, consumed))
+		{
+			waited = true;
+			spaceFreed.wait(lock);
+		}
+		if (waited) stats.waits++;
+		if (!stopping)
+		{
+			RingAllocation allocation = { consumed, 0, false };
+			allocations.push_back(allocation);
+			block->allocation = &allocations.back();
+			block->offset = offset;
+			block->data = mapped + offset;
+			return block;
+		}
+	}
+	block->owned.resize(bytes);
+	block->data = bytes > 0 ? &block->owned[0] : NULL;
+	return block;
+}
+
+void UploadManager::submit(const StagingHandle& block, const std::function<void(const StagingBlock&)>& issue)
+{
+	Upload upload = { block, issue };
+	std::lock_guard<std::mutex> lock(mutex);
+	queue.push_back(upload);
+}
+
+void UploadManager::retire()
+{
+	//Frames finish in order, so stop at the first fence that hasn't signalled
+	while (!fences.empty())
+	{
+		GLenum status = glClientWaitSync(fences.front().first, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+		completedSerial = fences.front().second;
+		glDeleteSync(fences.front().first);
+		fences.pop_front();
+	}
+
+	bool freed = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (!allocations.empty() && allocations.front().issued && allocations.front().serial <= completedSerial)
+		{
+			used -= allocations.front().consumed;
+			allocations.pop_front();
+			freed = true;
+		}
+	}
+	if (freed) spaceFreed.notify_all();
+}
+
+void UploadManager::process()
+{
+	retire();
+	serial++;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	size_t issuedBytes = 0;
+	bool usedRing = false;
+	if (ring) glBindBuffer(GL_COPY_READ_BUFFER, ring);
+	while (true)
+	{
+		Upload upload;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (queue.empty()) break;
+			upload = queue.front();
+			queue.pop_front();
+		}
+
+		const StagingBlock& block = *upload.block;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, block.inRing() ? ring : 0);
+		upload.issue(block);
+		issuedBytes += block.size();
+		usedRing = usedRing || block.inRing();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (block.allocation)
+			{
+				block.allocation->serial = serial;
+				block.allocation->issued = true;
+			}
+			stats.bytes += block.size();
+			stats.uploads++;
+		}
+
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (issuedBytes >= byteBudget || elapsed >= timeBudget) break;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	//Everything this frame copied out of the ring is free to overwrite once the GPU gets past here
+	if (usedRing) fences.push_back(std::make_pair(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), serial));
+}
+
+void UploadManager::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	spaceFreed.notify_all();
+}
+
+UploadStats UploadManager::getStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	UploadStats current = stats;
+	current.queued = (int)queue.size();
+	current.ringUsed = used;
+	return current;
+}
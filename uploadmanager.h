@@ -0,0 +1,122 @@
+#ifndef UPLOADMANAGER_H
+#define UPLOADMANAGER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <GL/glew.h>
+
+//Ring space handed to one block, freed once its upload has been issued and the frame it went out in has finished on the GPU
+struct RingAllocation
+{
+	size_t consumed;            //Bytes taken from the ring, including any skipped at the end when it wrapped
+	unsigned long long serial;  //Frame the upload was issued in
+	bool issued;
+};
+
+//Staging memory for one asset. A worker fills getData() and hands it back with UploadManager::submit(),
+//then the GL thread copies out of it with copyToBuffer() and getPixels().
+class StagingBlock
+{
+protected:
+	unsigned char* data;
+	size_t offset;                     //Into the ring
+	size_t bytes;
+	RingAllocation* allocation;        //NULL when the block lives in owned instead
+	std::vector<unsigned char> owned;  //Used when the ring is full for good, too small or not supported
+
+	friend class UploadManager;
+
+	//Owns ring space, so not copyable
+	StagingBlock(const StagingBlock&);
+	StagingBlock& operator=(const StagingBlock&);
+
+public:
+	StagingBlock() : data(NULL), offset(0), bytes(0), allocation(NULL) {}
+
+	unsigned char* getData() { return data; }
+	size_t size() const { return bytes; }
+	bool inRing() const { return allocation != NULL; }
+
+	//GL thread, during the upload: copy part of the block into the buffer bound to target
+	void copyToBuffer(GLenum target, size_t dstOffset, size_t srcOffset, size_t count) const;
+	//GL thread, during the upload: the data pointer to give glTex(Sub)Image and glCompressedTex(Sub)Image.
+	//An offset into the ring, which is bound as the pixel unpack buffer, or a plain pointer.
+	const void* getPixels(size_t srcOffset) const;
+};
+typedef std::shared_ptr<StagingBlock> StagingHandle;
+
+struct UploadStats
+{
+	unsigned long long bytes; //Issued since startup
+	int uploads;              //Ditto
+	int queued;               //Submitted and waiting for a later frame's budget
+	int waits;                //Times a worker had to wait for ring space
+	size_t ringUsed;
+	size_t ringSize;          //0 without ARB_buffer_storage, everything is staged in client memory then
+};
+
+//Streams asset data to the GPU without stalling the frame. Workers copy into a persistently mapped staging
+//ring, the GL thread turns each submitted block into buffer and texture copies out of the ring, up to a
+//budget of bytes and time per frame, and a fence per frame tells it when that part of the ring can be
+//written again. Must be created, processed and destroyed on the thread that owns the GL context.
+class UploadManager
+{
+protected:
+	struct Upload
+	{
+		StagingHandle block;
+		std::function<void(const StagingBlock&)> issue;
+	};
+
+	GLuint ring;
+	unsigned char* mapped;
+	size_t ringSize;
+	size_t head;                         //Where the next allocation starts
+	size_t used;                         //Bytes between the oldest live allocation and head
+	std::deque<RingAllocation> allocations; //Oldest first, references stay valid as the deque only changes at its ends
+	std::deque<std::pair<GLsync, unsigned long long> > fences; //One per frame that copied out of the ring, GL thread only
+	unsigned long long serial;           //Frames processed
+	unsigned long long completedSerial;  //Last frame the GPU is known to have finished with the ring
+	std::deque<Upload> queue;
+	std::mutex mutex;                    //Guards the ring bookkeeping, the queue and stats
+	std::condition_variable spaceFreed;
+	bool stopping;
+	size_t byteBudget;
+	double timeBudget;                   //Milliseconds
+	UploadStats stats;
+
+	bool allocateRing(size_t bytes, size_t& offset, size_t& consumed);
+	void retire();
+
+	//Owns the ring and its fences, so not copyable
+	UploadManager(const UploadManager&);
+	UploadManager& operator=(const UploadManager&);
+
+public:
+	UploadManager(size_t ringSize = 32 << 20);
+	~UploadManager();
+
+	//How much process() may issue each frame. At least one upload always goes out so big ones still make progress.
+	void setBudget(size_t bytesPerFrame, double millisPerFrame) { byteBudget = bytesPerFrame; timeBudget = millisPerFrame; }
+
+	//Any thread: staging space for one asset, waits while the ring is full. Allocate everything an asset needs
+	//in one block, a worker holding ring space while it waits for more could wait forever.
+	StagingHandle allocate(size_t bytes);
+	//Any thread: issue runs on the GL thread in a later process(), with the block ready to copy out of
+	void submit(const StagingHandle& block, const std::function<void(const StagingBlock&)>& issue);
+
+	//GL thread, once per frame: reclaim finished ring space and issue uploads up to the budget
+	void process();
+
+	//Stop workers waiting for ring space, anything they allocate from now on is staged in client memory
+	void shutdown();
+
+	UploadStats getStats();
+};
+
+#endif // UPLOADMANAGER_H